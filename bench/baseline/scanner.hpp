@@ -0,0 +1,117 @@
+#pragma once
+
+// the scanner as it was before the simd paths, bench_scanner_baseline measures it on the same input
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "types/token.hpp"
+
+class Scanner
+{
+public:
+
+    Scanner(std::string_view source)
+    :
+        m_source(source)
+    {}
+
+    // reads the source from fd a block at a time as it is scanned so it never has to be in memory all at once.
+    // lexemes are interned since the block they were read from gets reused
+    explicit Scanner(int fd)
+    :
+        m_fd(fd)
+    {}
+
+    // the size of the blocks read in streaming mode
+    static constexpr size_t BlockSize = 64 * 1024;
+
+    bool is_streaming() const
+    {
+        return m_fd >= 0;
+    }
+
+    Token scan_token();
+
+    Token scan_fstring();
+
+    struct Position
+    {
+        size_t offset;
+        size_t line;
+        size_t column;
+    };
+
+    // used to come back to a part of the source later, like the body of a lazily compiled function.
+    // a streaming scanner has already dropped what it scanned so it cannot seek back to it
+    Position position() const
+    {
+        return {m_discarded + m_offset, m_line, m_column};
+    }
+
+    std::string_view source() const
+    {
+        return m_source;
+    }
+
+    void seek(Position position)
+    {
+        m_offset = position.offset;
+        m_start  = position.offset;
+        m_line   = position.line;
+        m_column = position.column;
+        m_in_fstring_brace = false;
+    }
+
+    struct State
+    {
+        uint32_t line;
+        uint32_t  column;
+        bool ok = true;
+        std::string_view message;
+    } state{};
+
+private:
+    size_t   m_offset = 0;
+    size_t   m_start  = 0;
+    size_t   m_line   = 1;
+    size_t   m_column = 1;
+
+    // the whole source, or the part of the block buffer still being scanned when streaming
+    std::string_view m_source;
+
+    int m_fd = -1;
+    bool m_input_done = false;
+    std::string m_buffer;
+    // how much of the input was dropped from the front of the buffer
+    size_t m_discarded = 0;
+
+    Token m_last;
+
+    bool m_in_fstring_brace = false;
+
+    Token build(TokenType kind);
+
+    // skips non-token chars
+    bool skip_chars();
+
+    Token scan_string();
+    Token scan_number();
+    Token scan_identifier();
+
+    // reads blocks until count chars past the offset are buffered, false if the input ends first
+    bool fill(size_t count);
+
+    static std::string_view intern(std::string_view lexeme);
+
+    bool at_end();
+    char advance();
+    bool match(char c);
+    bool match_next(char c);
+    char peek();
+    char peek_next();
+    bool is_alpha(char c) const;
+
+    void error(std::string_view message);
+};
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/objects/channel.hpp"
+#include "../src/objects/string.hpp"
+
+/*
+ * channel throughput in millions of values per second with 1:1, 2:2 and 4:4 senders to receivers, for ints and for
+ * strings handed over without a copy, against the same bounded queue behind a mutex and two condition variables
+ */
+
+struct LockedQueue
+{
+    explicit LockedQueue(size_t capacity) :
+        m_capacity(capacity)
+    {}
+
+    void send(Value &&value)
+    {
+        std::unique_lock lock(m_mutex);
+
+        m_not_full.wait(lock, [this] { return m_values.size() < m_capacity; });
+
+        m_values.push_back(std::move(value));
+
+        lock.unlock();
+        m_not_empty.notify_one();
+    }
+
+    Value recv()
+    {
+        std::unique_lock lock(m_mutex);
+
+        m_not_empty.wait(lock, [this] { return !m_values.empty(); });
+
+        Value value = std::move(m_values.front());
+        m_values.pop_front();
+
+        lock.unlock();
+        m_not_full.notify_one();
+
+        return value;
+    }
+
+private:
+    size_t m_capacity;
+
+    std::mutex m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+    std::deque<Value> m_values;
+};
+
+constexpr size_t Capacity = 1024;
+constexpr size_t Messages = 1 << 20;
+
+// every sender sends its share of the messages and every receiver takes its share, checksums must match
+template<typename Queue>
+double measure(size_t senders, size_t receivers, bool strings)
+{
+    Queue queue(Capacity);
+
+    std::atomic<size_t> received_sum = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+
+    for(size_t i = 0; i < senders; i++)
+    {
+        threads.emplace_back([&, i]
+        {
+            for(size_t n = i; n < Messages; n += senders)
+            {
+                if(strings)
+                    queue.send(Value(new String(std::to_string(n))));
+                else
+                    queue.send(Value((int64_t)n));
+            }
+        });
+    }
+
+    for(size_t i = 0; i < receivers; i++)
+    {
+        threads.emplace_back([&, i]
+        {
+            size_t sum = 0;
+
+            for(size_t n = i; n < Messages; n += receivers)
+            {
+                Value value = queue.recv();
+
+                sum += strings ? value.get<String>()->data.size() : value.as.integer;
+            }
+
+            received_sum += sum;
+        });
+    }
+
+    for(auto &thread : threads)
+        thread.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t expected = 0;
+
+    for(size_t n = 0; n < Messages; n++)
+        expected += strings ? std::to_string(n).size() : n;
+
+    if(received_sum != expected)
+    {
+        std::fprintf(stderr, "values were lost\n");
+        std::exit(1);
+    }
+
+    return Messages / elapsed.count() / 1e6;
+}
+
+int main()
+{
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+    for(size_t threads : {1, 2, 4})
+    {
+        for(bool strings : {false, true})
+        {
+            double locked = measure<LockedQueue>(threads, threads, strings);
+            double ring   = measure<Ring>(threads, threads, strings);
+
+            std::printf("%zu:%zu %-7s mutex: %6.2f M/s  ring: %6.2f M/s (%.1fx)\n",
+                        threads, threads, strings ? "strings" : "ints", locked, ring, ring / locked);
+        }
+    }
+}
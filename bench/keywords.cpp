@@ -0,0 +1,75 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "../src/types/keywords.hpp"
+
+/*
+ * keyword classification on its own, the perfect hash against the unordered_map lookup the scanner used to do
+ * (contains followed by at), over a mix of keywords and identifiers like the ones in generated scripts
+ */
+
+const std::unordered_map<std::string_view, TokenType> g_keywords = []
+{
+    std::unordered_map<std::string_view, TokenType> map;
+
+    for(auto &keyword : keywords::list)
+        map.emplace(keyword.text, keyword.type);
+
+    return map;
+}();
+
+TokenType map_lookup(std::string_view text)
+{
+    return !g_keywords.contains(text) ? TokenType::Identifier : g_keywords.at(text);
+}
+
+template<typename Classify>
+double measure(const std::vector<std::string_view> &words, Classify classify, size_t &checksum)
+{
+    constexpr int Runs = 50;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < Runs; i++)
+    {
+        for(auto word : words)
+            checksum += (size_t)classify(word);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return (double)words.size() * Runs / elapsed.count() / 1e6;
+}
+
+int main()
+{
+    std::vector<std::string> storage;
+
+    for(size_t i = 0; i < 100000; i++)
+    {
+        storage.push_back("record_" + std::to_string(i));
+        storage.push_back("argument_one");
+        storage.push_back(std::string{keywords::list[i % std::size(keywords::list)].text});
+        storage.push_back("x");
+    }
+
+    std::vector<std::string_view> words(storage.begin(), storage.end());
+
+    size_t map_sum  = 0;
+    size_t hash_sum = 0;
+
+    double map_rate  = measure(words, map_lookup, map_sum);
+    double hash_rate = measure(words, keywords::type_of, hash_sum);
+
+    if(map_sum != hash_sum)
+    {
+        std::fprintf(stderr, "classifications differ\n");
+        return 1;
+    }
+
+    std::printf("unordered_map: %.1f M words/s\n", map_rate);
+    std::printf("perfect hash:  %.1f M words/s (%.1fx)\n", hash_rate, hash_rate / map_rate);
+}
@@ -0,0 +1,100 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#ifdef STRIX_BENCH_BASELINE
+#include "baseline/scanner.hpp"
+#else
+#include "../src/scanner.hpp"
+#endif
+#include "../src/util/util.hpp"
+#include "../src/util/simd.hpp"
+
+/*
+ * scanner throughput in MB/s over the file given as the first argument or a generated source shaped like
+ * the generated scripts the scanner is tuned for. built three times, bench_scanner_scalar has the simd paths compiled out
+ * and bench_scanner_baseline runs the scanner from before them
+ */
+
+std::string generate(size_t size)
+{
+    std::string source;
+
+    for(size_t i = 0; source.size() < size; i++)
+    {
+        std::string n = std::to_string(i);
+
+        source += "// entry " + n + " of the generated table, kept in sync with the schema\n";
+        source += "var record_" + n + "_identifier = \"value for record number " + n + " in the table\"\n";
+        source += "fn handle_record_" + n + "(argument_one, argument_two) {\n";
+        source += "    if argument_one > " + n + " { return argument_two + record_" + n + "_identifier }\n";
+        source += "    /* fall back to the default */\n";
+        source += "    return nil\n}\n\n";
+    }
+
+    return source;
+}
+
+size_t scan_all(std::string_view source)
+{
+    Scanner scanner(source);
+
+    size_t count = 0;
+
+    for(Token token; (token = scanner.scan_token()).type != TokenType::Eof; count++)
+    {
+        if(token.type != TokenType::FStringStart)
+            continue;
+
+        while(token.type != TokenType::Eof && token.type != TokenType::FStringEnd)
+            token = scanner.scan_fstring();
+    }
+
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    std::optional<SourceFile> file;
+    std::string generated;
+    std::string_view source;
+
+    if(argc >= 2)
+    {
+        file = read_file(argv[1]);
+
+        if(!file.has_value())
+        {
+            std::fprintf(stderr, "could not read input file\n");
+            return 1;
+        }
+
+        source = file->view();
+    }
+    else
+    {
+        generated = generate(16 * 1024 * 1024);
+        source = generated;
+    }
+
+    constexpr int Runs = 10;
+
+    size_t tokens = scan_all(source);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for(int i = 0; i < Runs; i++)
+        tokens = scan_all(source);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double megabytes = (double)source.size() * Runs / (1024 * 1024);
+
+#ifdef STRIX_BENCH_BASELINE
+    const char *name = "baseline";
+#else
+    const char *name = STRIX_SSE2 ? "sse2" : "scalar";
+#endif
+
+    std::printf("%s: %zu tokens, %.1f MB/s\n", name, tokens, megabytes / elapsed.count());
+}
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "strix.h"
+
+/*
+ * a c host loading a script once and calling its functions by name, the way a service would per request
+ */
+
+static const char *Script =
+    "fn fib(n)\n"
+    "{\n"
+    "    if n < 2\n"
+    "        return n\n"
+    "    return fib(n-1) + fib(n-2)\n"
+    "}\n"
+    "\n"
+    "fn greet(name) = f\"hello {name}\"\n"
+    "\n"
+    "fn checked(n)\n"
+    "{\n"
+    "    if n < 0\n"
+    "        panic(\"negative\")\n"
+    "    return n\n"
+    "}\n";
+
+int main(void)
+{
+    strix_vm *vm = strix_new();
+
+    if(strix_load(vm, Script, strlen(Script)) != STRIX_OK)
+        return 1;
+
+    strix_function *fib     = strix_find(vm, "fib");
+    strix_function *greet   = strix_find(vm, "greet");
+    strix_function *checked = strix_find(vm, "checked");
+
+    if(!fib || !greet || !checked || strix_find(vm, "missing"))
+        return 1;
+
+    // the handle is found once and called as often as needed
+    int64_t total = 0;
+
+    for(int64_t i = 0; i < 20; i++)
+    {
+        strix_push_int(vm, i);
+
+        if(strix_call(vm, fib, 1) != STRIX_OK)
+            return 1;
+
+        total += strix_pop_int(vm);
+    }
+
+    printf("sum of fib(0..20) = %lld\n", (long long)total);
+
+    char buffer[64];
+
+    strix_push_string(vm, "host", 4);
+
+    if(strix_call(vm, greet, 1) != STRIX_OK || strix_top(vm) != STRIX_STRING)
+        return 1;
+
+    size_t length = strix_pop_string(vm, buffer, sizeof(buffer) - 1);
+
+    buffer[length < sizeof(buffer) - 1 ? length : sizeof(buffer) - 1] = '\0';
+
+    printf("%s\n", buffer);
+
+    // a failed call leaves the vm usable
+    strix_push_int(vm, -1);
+
+    if(strix_call(vm, checked, 1) != STRIX_RUNTIME_ERROR)
+        return 1;
+
+    strix_push_int(vm, 7);
+
+    if(strix_call(vm, checked, 1) != STRIX_OK)
+        return 1;
+
+    int64_t result = strix_pop_int(vm);
+
+    printf("\nchecked(7) = %lld, %zu values left\n", (long long)result, strix_depth(vm));
+
+    strix_free(vm);
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#include <cmath>
+#include <string>
+
+#include "strix.hpp"
+
+/*
+ * a host giving a script a few of its own functions, each one is a plain c++ function the script calls by name
+ */
+
+int64_t gcd(int64_t a, int64_t b)
+{
+    while(b != 0)
+        a = std::exchange(b, a % b);
+
+    return a;
+}
+
+std::string repeat(std::string_view text, int64_t times)
+{
+    std::string result;
+
+    for(int64_t i = 0; i < times; i++)
+        result += text;
+
+    return result;
+}
+
+// nil when there is no real root
+std::optional<double> root(double x)
+{
+    if(x < 0)
+        return std::nullopt;
+
+    return std::sqrt(x);
+}
+
+// takes the vm to report its own errors
+double divide(VM &vm, double a, double b)
+{
+    if(b == 0)
+        vm.runtime_error("division by zero");
+
+    return a / b;
+}
+
+constexpr std::string_view Script = R"(
+fn main()
+{
+    println(gcd(84, 36))
+    println(repeat("ab", 3))
+    println(root(16))
+    println(root(-1))
+    println(shout("hello"))
+    println(divide(1, 4))
+    divide(1, 0)
+}
+)";
+
+int main()
+{
+    strix::define<gcd>("gcd");
+    strix::define<repeat>("repeat");
+    strix::define<root>("root");
+    strix::define<divide>("divide");
+
+    // lambdas without captures work as well
+    strix::define<[](std::string_view text) { return std::string(text) + "!"; }>("shout");
+
+    static_assert(strix::arity<divide> == 2);
+
+    VM vm;
+
+    return vm.interpret(Script) == InterpretResult::Ok ? 0 : 1;
+}
@@ -0,0 +1,835 @@
+#include <cerrno>
+#include <cstring>
+#include <unordered_set>
+#include <unordered_map>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.hpp"
+#include "objects/string.hpp"
+#include "objects/tuple.hpp"
+#include "objects/map.hpp"
+#include "objects/jump_table.hpp"
+#include "objects/native_function.hpp"
+
+/*
+ * file layout, all integers are native endian
+ *
+ * header   magic "strixc\0\0", format version, opcode set hash, native table hash, source size, source mtime,
+ *          source hash, hash of everything after the header
+ * function name, param count, slot count, captures, upvalues, instructions (8 byte aligned), constants
+ * constant one byte tag followed by the value, nested functions are written in place
+ * upvalue  index into the upvalues written so far, followed by its closed value the first time it is seen
+ *
+ * images use the same header with the magic "strixi\0\0" followed by the global count, the globals
+ * and the entry program. modules are cached like programs with the magic "strixm\0\0"
+ */
+
+namespace
+{
+    constexpr char Magic[8]       = {'s', 't', 'r', 'i', 'x', 'c', '\0', '\0'};
+    constexpr char ImageMagic[8]  = {'s', 't', 'r', 'i', 'x', 'i', '\0', '\0'};
+    constexpr char ModuleMagic[8] = {'s', 't', 'r', 'i', 'x', 'm', '\0', '\0'};
+
+    enum class Tag : uint8_t
+    {
+        Number, Int, Bool, Nil, String, Function, NativeFunction, Tuple, JumpTable, Map,
+    };
+
+    enum class NameKind : uint8_t
+    {
+        // offset and length into the source
+        Source,
+        // the characters follow inline, used for names the compiler made up like "fn()"
+        Inline,
+    };
+
+    static_assert(std::is_trivially_copyable_v<Bytes>, "instructions are copied into the cache as a block");
+
+    // FNV-1a, stable across builds unlike std::hash
+    uint64_t hash_of(std::string_view data)
+    {
+        uint64_t hash = 0xCBF29CE484222325ull;
+
+        for(unsigned char c : data)
+        {
+            hash ^= c;
+            hash *= 0x100000001B3ull;
+        }
+
+        return hash;
+    }
+
+    // changes whenever an opcode is added, removed or reordered so stale caches are never run
+    uint64_t opcode_set_hash()
+    {
+        static const uint64_t hash = []
+        {
+            std::string names;
+
+            for(auto name : opcode_str)
+                names.append(name).push_back(',');
+
+            return hash_of(names);
+        }();
+
+        return hash;
+    }
+
+    // changes whenever the native table does, CallNative instructions refer to natives by their place in it
+    uint64_t native_set_hash()
+    {
+        std::string names;
+
+        for(auto &native : builtin::natives())
+            names.append(native.name).append(std::to_string(native.param_count)).push_back(',');
+
+        return hash_of(names);
+    }
+
+    struct Header
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t instruction_size;
+        uint64_t opcode_hash;
+        uint64_t native_hash;
+        uint64_t source_size;
+        int64_t  source_mtime;
+        uint64_t source_hash;
+        // a torn or corrupted file is never read, the instructions in it are run without further checks
+        uint64_t body_hash;
+    };
+
+    std::optional<int64_t> mtime_of(const std::filesystem::path &path)
+    {
+        std::error_code error;
+
+        auto time = std::filesystem::last_write_time(path, error);
+
+        if(error)
+            return std::nullopt;
+
+        return time.time_since_epoch().count();
+    }
+
+    Header header_for(const char (&magic)[8], std::string_view source, int64_t mtime)
+    {
+        Header header{};
+
+        std::memcpy(header.magic, magic, sizeof(header.magic));
+
+        header.version          = cache::FormatVersion;
+        header.instruction_size = sizeof(Bytes);
+        header.opcode_hash      = opcode_set_hash();
+        header.native_hash      = native_set_hash();
+        header.source_size      = source.size();
+        header.source_mtime     = mtime;
+        header.source_hash      = hash_of(source);
+
+        return header;
+    }
+
+    class Writer
+    {
+    public:
+        explicit Writer(std::string_view source) :
+            m_source(source)
+        {}
+
+        std::string buffer;
+
+        // cleared if a value cannot be written, like an address or an upvalue that is still open
+        bool ok = true;
+
+        template<typename T>
+        void write(T value)
+        {
+            buffer.append((const char*)&value, sizeof(T));
+        }
+
+        void write_string(std::string_view string)
+        {
+            write((uint32_t)string.size());
+            buffer.append(string);
+        }
+
+        void align(size_t alignment)
+        {
+            buffer.resize((buffer.size() + alignment - 1) / alignment * alignment, '\0');
+        }
+
+        void write_function(const Function &fn)
+        {
+            write_name(fn.name);
+
+            write(fn.param_count);
+            write(fn.slot_count);
+
+            write((uint32_t)fn.captures.size());
+
+            for(auto &capture : fn.captures)
+            {
+                write(capture.is_local);
+                write(capture.index);
+            }
+
+            write((uint32_t)fn.upvalues.size());
+
+            for(auto &upvalue : fn.upvalues)
+                write_upvalue(*upvalue);
+
+            // the body only exists as source until the first call, and module globals only exist in this process
+            if(fn.lazy || fn.globals)
+                ok = false;
+
+            auto &bytes = fn.chunk->bytes;
+
+            write((uint32_t)bytes.size());
+
+            align(alignof(uint64_t));
+
+            // written field by field so the padding inside Bytes is zeroed instead of copied
+            size_t start = buffer.size();
+
+            buffer.resize(start + bytes.size() * sizeof(Bytes), '\0');
+
+            for(size_t i = 0; i < bytes.size(); i++)
+            {
+                char *out = buffer.data() + start + i * sizeof(Bytes);
+
+                std::memcpy(out + offsetof(Bytes, code), &bytes[i].code, sizeof(OpCode));
+                std::memcpy(out + offsetof(Bytes, constant), &bytes[i].constant, sizeof(uint16_t));
+                std::memcpy(out + offsetof(Bytes, line), &bytes[i].line, sizeof(uint32_t));
+            }
+
+            write((uint32_t)fn.chunk->constants.size());
+
+            for(auto &constant : fn.chunk->constants)
+                write_value(constant);
+        }
+
+        void write_value(const Value &value)
+        {
+            switch(value.type)
+            {
+                case ValueType::Number:
+                    write(Tag::Number);
+                    return write(value.as.number);
+                case ValueType::Int:
+                    write(Tag::Int);
+                    return write(value.as.integer);
+                case ValueType::Bool:
+                    write(Tag::Bool);
+                    return write(value.as.boolean);
+                case ValueType::Object:
+                    return write_object(value.as.object);
+                case ValueType::Address:
+                    ok = false;
+                    return write(Tag::Nil);
+                default:
+                    return write(Tag::Nil);
+            }
+        }
+
+    private:
+        std::string_view m_source;
+
+        // closures that shared an upvalue keep sharing it once read back
+        std::unordered_map<const Upvalue*, uint32_t> m_upvalues;
+
+        void write_upvalue(const Upvalue &upvalue)
+        {
+            auto [it, inserted] = m_upvalues.emplace(&upvalue, m_upvalues.size());
+
+            write(it->second);
+
+            if(!inserted)
+                return;
+
+            if(upvalue.location != &upvalue.closed)
+                ok = false;
+
+            write_value(upvalue.closed);
+        }
+
+        void write_name(std::string_view name)
+        {
+            const char *begin = m_source.data();
+            const char *end   = m_source.data() + m_source.size();
+
+            if(name.data() >= begin && name.data() + name.size() <= end)
+            {
+                write(NameKind::Source);
+                write((uint32_t)(name.data() - begin));
+                write((uint32_t)name.size());
+            }
+            else
+            {
+                write(NameKind::Inline);
+                write_string(name);
+            }
+        }
+
+        void write_object(const Object *object)
+        {
+            switch(object->type())
+            {
+                case ObjectType::String:
+                    write(Tag::String);
+                    return write_string(static_cast<const String*>(object)->data);
+                case ObjectType::Function:
+                    write(Tag::Function);
+                    return write_function(*static_cast<const Function*>(object));
+                case ObjectType::NativeFunction:
+                    write(Tag::NativeFunction);
+                    return write_string(static_cast<const NativeFunction*>(object)->name);
+                case ObjectType::Tuple:
+                {
+                    auto tuple = static_cast<const Tuple*>(object);
+
+                    write(Tag::Tuple);
+                    write(tuple->length);
+
+                    // empty for the tuple constants the compiler makes, only runtime tuples hold values
+                    write((uint32_t)tuple->data.size());
+
+                    for(auto &value : tuple->data)
+                        write_value(value);
+
+                    return;
+                }
+                case ObjectType::Map:
+                {
+                    auto map = static_cast<const Map*>(object);
+
+                    write(Tag::Map);
+                    write(map->length);
+
+                    for(auto &bucket : map->buckets)
+                    {
+                        if(bucket.distance == 0)
+                            continue;
+
+                        write_value(bucket.key);
+                        write_value(bucket.value);
+                    }
+
+                    return;
+                }
+                case ObjectType::JumpTable:
+                {
+                    auto table = static_cast<const JumpTable*>(object);
+
+                    write(Tag::JumpTable);
+                    write((uint64_t)table->default_target);
+                    write(table->low);
+
+                    write((uint32_t)table->targets.size());
+
+                    for(size_t target : table->targets)
+                        write((uint64_t)target);
+
+                    write((uint32_t)table->cases.length);
+
+                    for(auto &bucket : table->cases.buckets)
+                    {
+                        if(bucket.distance == 0)
+                            continue;
+
+                        write_value(bucket.key);
+                        write(bucket.value.as.integer);
+                    }
+
+                    return;
+                }
+                // coroutines, tasks and channels are only meaningful to the process running them
+                case ObjectType::Coroutine:
+                case ObjectType::Task:
+                case ObjectType::Channel:
+                    ok = false;
+                    return write(Tag::Nil);
+                default:
+                    write(Tag::Nil);
+            }
+        }
+    };
+
+    class Reader
+    {
+    public:
+        Reader(std::string_view data, std::string_view source) :
+            m_data(data),
+            m_source(source)
+        {}
+
+        bool ok = true;
+
+        template<typename T>
+        T read()
+        {
+            T value{};
+
+            if(!has(sizeof(T)))
+                return value;
+
+            std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+            m_offset += sizeof(T);
+
+            return value;
+        }
+
+        std::string_view read_string()
+        {
+            uint32_t size = read<uint32_t>();
+
+            if(!has(size))
+                return {};
+
+            std::string_view string = m_data.substr(m_offset, size);
+            m_offset += size;
+
+            return string;
+        }
+
+        void align(size_t alignment)
+        {
+            m_offset = (m_offset + alignment - 1) / alignment * alignment;
+        }
+
+        bool read_function(Function &fn)
+        {
+            fn.name        = read_name();
+            fn.param_count = read<uint8_t>();
+            fn.slot_count  = read<uint16_t>();
+
+            uint32_t capture_count = read<uint32_t>();
+
+            for(uint32_t i = 0; i < capture_count && ok; i++)
+            {
+                Capture capture{};
+
+                capture.is_local = read<bool>();
+                capture.index    = read<uint16_t>();
+
+                fn.captures.push_back(capture);
+            }
+
+            uint32_t upvalue_count = read<uint32_t>();
+
+            for(uint32_t i = 0; i < upvalue_count && ok; i++)
+                fn.upvalues.push_back(read_upvalue());
+
+            uint32_t byte_count = read<uint32_t>();
+
+            align(alignof(uint64_t));
+
+            if(!has((size_t)byte_count * sizeof(Bytes)))
+                return false;
+
+            // the instructions are stored exactly as they are laid out in memory so they are copied as one block
+            auto bytes = (const Bytes*)(m_data.data() + m_offset);
+
+            fn.chunk->bytes.assign(bytes, bytes + byte_count);
+            m_offset += byte_count * sizeof(Bytes);
+
+            for(auto &byte : fn.chunk->bytes)
+            {
+                if((size_t)byte.code >= std::size(opcode_str))
+                    return ok = false;
+            }
+
+            uint32_t constant_count = read<uint32_t>();
+
+            fn.chunk->constants.reserve(std::min<size_t>(constant_count, m_data.size()));
+
+            for(uint32_t i = 0; i < constant_count && ok; i++)
+                fn.chunk->constants.push_back(read_value());
+
+            return ok;
+        }
+
+        Value read_value()
+        {
+            switch(read<Tag>())
+            {
+                case Tag::Number: return Value(read<double>());
+                case Tag::Int:    return Value(read<int64_t>());
+                case Tag::Bool:   return Value(read<bool>());
+                case Tag::Nil:    return Value(nullptr);
+                // copied into an owned string since the cache file does not outlive the program
+                case Tag::String: return new String(std::string(read_string()));
+                case Tag::Tuple:
+                {
+                    auto tuple = new Tuple(read<uint8_t>());
+                    Value value = tuple;
+
+                    uint32_t count = read<uint32_t>();
+
+                    for(uint32_t i = 0; i < count && ok; i++)
+                        tuple->data.push_back(read_value());
+
+                    return value;
+                }
+                case Tag::Map:
+                {
+                    uint32_t length = read<uint32_t>();
+
+                    auto map = new Map(std::min<size_t>(length, m_data.size()));
+                    Value value = map;
+
+                    for(uint32_t i = 0; i < length && ok; i++)
+                    {
+                        Value key = read_value();
+
+                        if(!Map::hashable(key))
+                        {
+                            ok = false;
+                            break;
+                        }
+
+                        map->set(std::move(key), read_value());
+                    }
+
+                    return value;
+                }
+                case Tag::Function:
+                {
+                    auto fn = new Function;
+                    Value value = fn;
+
+                    read_function(*fn);
+
+                    return value;
+                }
+                case Tag::NativeFunction:
+                {
+                    std::string_view name = read_string();
+
+                    for(auto &native : builtin::natives())
+                    {
+                        if(native.name == name)
+                            return new NativeFunction(native);
+                    }
+
+                    ok = false;
+                    return Value(nullptr);
+                }
+                case Tag::JumpTable:
+                {
+                    auto table = new JumpTable(read<uint64_t>());
+                    Value value = table;
+
+                    table->low = read<int64_t>();
+
+                    uint32_t target_count = read<uint32_t>();
+
+                    if(!has((size_t)target_count * sizeof(uint64_t)))
+                        return value;
+
+                    for(uint32_t i = 0; i < target_count; i++)
+                        table->targets.push_back(read<uint64_t>());
+
+                    uint32_t case_count = read<uint32_t>();
+
+                    for(uint32_t i = 0; i < case_count && ok; i++)
+                    {
+                        Value key = read_value();
+
+                        if(!Map::hashable(key))
+                        {
+                            ok = false;
+                            break;
+                        }
+
+                        table->cases.set(std::move(key), Value(read<int64_t>()));
+                    }
+
+                    return value;
+                }
+                default:
+                    ok = false;
+                    return Value(nullptr);
+            }
+        }
+
+    private:
+        std::string_view m_data;
+        std::string_view m_source;
+        size_t m_offset = 0;
+
+        std::vector<std::shared_ptr<Upvalue>> m_upvalues;
+
+        bool has(size_t size)
+        {
+            if(m_offset + size > m_data.size())
+                ok = false;
+            return ok;
+        }
+
+        std::string_view read_name()
+        {
+            auto kind = read<NameKind>();
+
+            if(kind == NameKind::Source)
+            {
+                uint32_t offset = read<uint32_t>();
+                uint32_t size   = read<uint32_t>();
+
+                if((size_t)offset + size > m_source.size())
+                {
+                    ok = false;
+                    return {};
+                }
+
+                return m_source.substr(offset, size);
+            }
+
+            // the cache file is unmapped after loading so made up names are kept here instead
+            static std::unordered_set<std::string> names;
+            static std::mutex mutex;
+
+            std::string_view name = read_string();
+
+            std::lock_guard lock(mutex);
+
+            return *names.emplace(name).first;
+        }
+
+        std::shared_ptr<Upvalue> read_upvalue()
+        {
+            uint32_t index = read<uint32_t>();
+
+            if(index < m_upvalues.size())
+                return m_upvalues[index];
+
+            if(index != m_upvalues.size())
+            {
+                ok = false;
+                return nullptr;
+            }
+
+            // closed upvalues point at their own value
+            auto upvalue = std::make_shared<Upvalue>(nullptr);
+
+            upvalue->location = &upvalue->closed;
+
+            m_upvalues.push_back(upvalue);
+
+            upvalue->closed = read_value();
+
+            return upvalue;
+        }
+    };
+}
+
+namespace
+{
+    // the file for the source if it exists and was written for the same source by a build with the same opcodes
+    std::optional<SourceFile> open_valid(std::filesystem::path path, const char (&magic)[8],
+                                         const std::filesystem::path &source_path, std::string_view source)
+    {
+        auto mtime = mtime_of(source_path);
+
+        if(!mtime.has_value())
+            return std::nullopt;
+
+        auto file = read_file(std::move(path));
+
+        if(!file.has_value())
+            return std::nullopt;
+
+        std::string_view data = file->view();
+
+        if(data.size() < sizeof(Header))
+            return std::nullopt;
+
+        Header header;
+
+        std::memcpy(&header, data.data(), sizeof(Header));
+
+        // cheap checks first so the source is only hashed when everything else matches
+        Header expected = header_for(magic, {}, mtime.value());
+
+        if(std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0
+           || header.version          != expected.version
+           || header.instruction_size != expected.instruction_size
+           || header.opcode_hash      != expected.opcode_hash
+           || header.native_hash      != expected.native_hash
+           || header.source_size      != source.size()
+           || header.source_mtime     != expected.source_mtime
+           || header.source_hash      != hash_of(source)
+           || header.body_hash        != hash_of(data.substr(sizeof(Header))))
+            return std::nullopt;
+
+        return file;
+    }
+
+    // fills in the hash of the body once all of it is written
+    void seal(std::string &buffer)
+    {
+        uint64_t hash = hash_of(std::string_view(buffer).substr(sizeof(Header)));
+
+        std::memcpy(buffer.data() + offsetof(Header, body_hash), &hash, sizeof(hash));
+    }
+
+    // written to a temporary file of its own first, so concurrent runs never see a half written file and never
+    // write into the same one before renaming it into place
+    bool write_atomically(const std::filesystem::path &path, std::string_view data)
+    {
+        std::string temp_path = path.string() + ".XXXXXX";
+
+        int fd = mkstemp(temp_path.data());
+
+        if(fd == -1)
+            return false;
+
+        bool written = true;
+
+        for(size_t offset = 0; offset < data.size() && written;)
+        {
+            ssize_t count = ::write(fd, data.data() + offset, data.size() - offset);
+
+            if(count == -1 && errno == EINTR)
+                continue;
+
+            written  = count > 0;
+            offset  += written ? count : 0;
+        }
+
+        // mkstemp creates the file readable by its owner only, caches are shared like the sources they are for
+        fchmod(fd, 0644);
+
+        written = close(fd) == 0 && written;
+
+        std::error_code error;
+
+        if(written)
+        {
+            std::filesystem::rename(temp_path, path, error);
+            written = !error;
+        }
+
+        if(!written)
+            std::filesystem::remove(temp_path, error);
+
+        return written;
+    }
+}
+
+namespace
+{
+    // main.strix -> main.strixc, other names keep their extension so scripts that only differ in it never share
+    // a cache, build -> build.strixc and build.sh -> build.sh.strixc
+    std::filesystem::path cache_path(const std::filesystem::path &source_path, char suffix)
+    {
+        std::filesystem::path path = source_path;
+
+        if(path.extension() != ".strix")
+            path += ".strix";
+
+        return path += suffix;
+    }
+}
+
+std::filesystem::path cache::path_of(const std::filesystem::path &source_path, Kind kind)
+{
+    return cache_path(source_path, kind == Kind::Module ? 'm' : 'c');
+}
+
+std::filesystem::path cache::image_path_of(const std::filesystem::path &source_path)
+{
+    return cache_path(source_path, 'i');
+}
+
+std::optional<Function> cache::load(const std::filesystem::path &source_path, std::string_view source, Kind kind)
+{
+    auto file = open_valid(path_of(source_path, kind), kind == Kind::Module ? ModuleMagic : Magic, source_path, source);
+
+    if(!file.has_value())
+        return std::nullopt;
+
+    Reader reader(file->view().substr(sizeof(Header)), source);
+
+    Function program;
+
+    if(!reader.read_function(program))
+        return std::nullopt;
+
+    return program;
+}
+
+bool cache::store(const std::filesystem::path &source_path, std::string_view source, const Function &program,
+                  Kind kind)
+{
+    auto mtime = mtime_of(source_path);
+
+    if(!mtime.has_value())
+        return false;
+
+    Writer writer(source);
+
+    Header header = header_for(kind == Kind::Module ? ModuleMagic : Magic, source, mtime.value());
+
+    writer.buffer.append((const char*)&header, sizeof(Header));
+
+    writer.write_function(program);
+
+    if(!writer.ok)
+        return false;
+
+    seal(writer.buffer);
+
+    return write_atomically(path_of(source_path, kind), writer.buffer);
+}
+
+std::optional<cache::Image> cache::load_image(const std::filesystem::path &source_path, std::string_view source)
+{
+    auto file = open_valid(image_path_of(source_path), ImageMagic, source_path, source);
+
+    if(!file.has_value())
+        return std::nullopt;
+
+    Reader reader(file->view().substr(sizeof(Header)), source);
+
+    Image image;
+
+    uint32_t global_count = reader.read<uint32_t>();
+
+    for(uint32_t i = 0; i < global_count && reader.ok; i++)
+        image.globals.push_back(reader.read_value());
+
+    if(!reader.ok || !reader.read_function(image.entry))
+        return std::nullopt;
+
+    return image;
+}
+
+bool cache::store_image(const std::filesystem::path &source_path, std::string_view source, const Image &image)
+{
+    auto mtime = mtime_of(source_path);
+
+    if(!mtime.has_value())
+        return false;
+
+    Writer writer(source);
+
+    Header header = header_for(ImageMagic, source, mtime.value());
+
+    writer.buffer.append((const char*)&header, sizeof(Header));
+
+    writer.write((uint32_t)image.globals.size());
+
+    for(auto &global : image.globals)
+        writer.write_value(global);
+
+    writer.write_function(image.entry);
+
+    if(!writer.ok)
+        return false;
+
+    seal(writer.buffer);
+
+    return write_atomically(image_path_of(source_path), writer.buffer);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <optional>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "objects/function.hpp"
+
+/*
+ * compiled programs are cached next to their source as <source>c (main.strix -> main.strixc), a source without
+ * the .strix extension gets it added first (build -> build.strixc)
+ * the cache records the size, modification time and hash of the source it was compiled from and
+ * is ignored if any of them changed, or if it was written by a build with a different set of opcodes.
+ * the rest of the file is hashed too so a torn or corrupted cache is recompiled instead of run
+ */
+namespace cache
+{
+    // bump whenever the layout of the file changes
+    constexpr uint32_t FormatVersion = 5;
+
+    // a source compiled as a module is a different program so it is cached apart as <source>m
+    enum class Kind : uint8_t
+    {
+        Program,
+        Module,
+    };
+
+    std::filesystem::path path_of(const std::filesystem::path &source_path, Kind kind = Kind::Program);
+
+    // the cached program for the source if there is a valid one
+    // function names point into source so it must outlive the program like it would for a compiled one
+    std::optional<Function> load(const std::filesystem::path &source_path, std::string_view source,
+                                 Kind kind = Kind::Program);
+
+    // writes the program to the cache, failing quietly since the cache is only an optimization
+    bool store(const std::filesystem::path &source_path, std::string_view source, const Function &program,
+               Kind kind = Kind::Program);
+
+    /*
+     * an image is the vms memory after the top level of a program has run, stored next to the source as
+     * <source>i (main.strix -> main.strixi, named like the cache). starting from one skips straight to main,
+     * so anything the top level printed or read is not repeated. it is validated against the source the same
+     * way the cache is
+     */
+    struct Image
+    {
+        // the global slots in order
+        std::vector<Value> globals;
+        // the rest of the program after the top level, usually just the call to main
+        Function entry;
+    };
+
+    std::filesystem::path image_path_of(const std::filesystem::path &source_path);
+
+    std::optional<Image> load_image(const std::filesystem::path &source_path, std::string_view source);
+
+    // fails if a global holds something that only makes sense in this process, like an address
+    bool store_image(const std::filesystem::path &source_path, std::string_view source, const Image &image);
+}
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "strix.h"
+#include "vm.hpp"
+#include "compiler.hpp"
+#include "cache.hpp"
+#include "objects/map.hpp"
+#include "objects/string.hpp"
+#include "util/fmt.hpp"
+
+struct strix_vm
+{
+    std::unique_ptr<VM> vm = std::make_unique<VM>();
+
+    // function names point into the source so it is kept as long as the program
+    std::string source;
+    std::optional<SourceFile> file;
+
+    // the globals of the program by name, what running a module gives back
+    Value exports;
+
+    // functions found so far, the nodes do not move so handles to them stay valid
+    std::unordered_map<std::string, Function> functions;
+};
+
+namespace
+{
+    strix_result result_of(InterpretResult result)
+    {
+        switch(result)
+        {
+            case InterpretResult::Ok:           return STRIX_OK;
+            case InterpretResult::CompileError: return STRIX_COMPILE_ERROR;
+            default:                            return STRIX_RUNTIME_ERROR;
+        }
+    }
+
+    // drops the program that was loaded before so the new one starts on a clean vm
+    void reset(strix_vm *vm)
+    {
+        vm->functions.clear();
+        vm->exports = Value(nullptr);
+        vm->vm = std::make_unique<VM>();
+    }
+
+    // programs are compiled as modules so the top level gives back its globals instead of calling main
+    strix_result run(strix_vm *vm, std::optional<Function> &&program)
+    {
+        if(!program.has_value())
+            return STRIX_COMPILE_ERROR;
+
+        InterpretResult result = vm->vm->interpret(std::move(program.value()));
+
+        if(result == InterpretResult::Ok)
+            vm->exports = vm->vm->pop();
+
+        return result_of(result);
+    }
+
+    Value pop(strix_vm *vm)
+    {
+        Value value = std::move(vm->vm->m_stack.back());
+        vm->vm->m_stack.pop_back();
+
+        return value;
+    }
+}
+
+strix_vm *strix_new(void)
+{
+    return new strix_vm;
+}
+
+void strix_free(strix_vm *vm)
+{
+    delete vm;
+}
+
+strix_result strix_load(strix_vm *vm, const char *source, size_t length)
+{
+    reset(vm);
+
+    vm->file.reset();
+    vm->source.assign(source, length);
+
+    Compiler compiler(vm->source);
+
+    return run(vm, compiler.compile_module());
+}
+
+strix_result strix_load_file(strix_vm *vm, const char *path)
+{
+    reset(vm);
+
+    vm->source.clear();
+    vm->file = read_file(path);
+
+    if(!vm->file.has_value())
+    {
+        fmt::eprint("could not read {}\n", path);
+        return STRIX_COMPILE_ERROR;
+    }
+
+    std::string_view source = vm->file->view();
+
+    auto program = cache::load(path, source, cache::Kind::Module);
+
+    if(!program.has_value())
+    {
+        Compiler compiler(source);
+
+        program = compiler.compile_module();
+
+        if(program.has_value())
+            cache::store(path, source, program.value(), cache::Kind::Module);
+    }
+
+    return run(vm, std::move(program));
+}
+
+strix_function *strix_find(strix_vm *vm, const char *name)
+{
+    if(auto it = vm->functions.find(name); it != vm->functions.end())
+        return reinterpret_cast<strix_function*>(&it->second);
+
+    auto exports = vm->exports.get<Map>();
+
+    if(!exports || !exports->is(ObjectType::Map))
+        return nullptr;
+
+    Value *value = exports->find(Value(new String(std::string_view(name))));
+
+    if(!value)
+        return nullptr;
+
+    // exports are the addresses of the globals
+    if(value->type == ValueType::Address)
+        value = value->as.address;
+
+    auto fn = value->get<Function>();
+
+    if(!fn || !fn->is(ObjectType::Function))
+        return nullptr;
+
+    auto [it, inserted] = vm->functions.emplace(name, *fn);
+
+    return reinterpret_cast<strix_function*>(&it->second);
+}
+
+strix_result strix_call(strix_vm *vm, strix_function *function, uint8_t arg_count)
+{
+    auto &fn    = *reinterpret_cast<Function*>(function);
+    auto &stack = vm->vm->m_stack;
+
+    if(arg_count > fn.param_count)
+    {
+        fmt::eprint("{} takes at most {} arguments\n", fn.name, (int)fn.param_count);
+
+        stack.resize(stack.size() - arg_count);
+
+        return STRIX_RUNTIME_ERROR;
+    }
+
+    // scripts pass the args with the first one on top, hosts push them in order
+    std::reverse(stack.end() - arg_count, stack.end());
+
+    return result_of(vm->vm->call_function(fn, arg_count));
+}
+
+void strix_push_nil(strix_vm *vm)
+{
+    vm->vm->m_stack.emplace_back(nullptr);
+}
+
+void strix_push_bool(strix_vm *vm, int value)
+{
+    vm->vm->m_stack.emplace_back(value != 0);
+}
+
+void strix_push_int(strix_vm *vm, int64_t value)
+{
+    vm->vm->m_stack.emplace_back(value);
+}
+
+void strix_push_number(strix_vm *vm, double value)
+{
+    vm->vm->m_stack.emplace_back(value);
+}
+
+void strix_push_string(strix_vm *vm, const char *string, size_t length)
+{
+    vm->vm->m_stack.emplace_back(new String(std::string(string, length)));
+}
+
+size_t strix_depth(strix_vm *vm)
+{
+    return vm->vm->m_stack.size();
+}
+
+strix_type strix_top(strix_vm *vm)
+{
+    const Value &value = vm->vm->m_stack.back();
+
+    switch(value.type)
+    {
+        case ValueType::Nil:    return STRIX_NIL;
+        case ValueType::Bool:   return STRIX_BOOL;
+        case ValueType::Int:    return STRIX_INT;
+        case ValueType::Number: return STRIX_NUMBER;
+        default:
+            return value.as.object->is(ObjectType::String) ? STRIX_STRING : STRIX_OBJECT;
+    }
+}
+
+void strix_pop(strix_vm *vm)
+{
+    vm->vm->m_stack.pop_back();
+}
+
+int strix_pop_bool(strix_vm *vm)
+{
+    return !pop(vm).is_falsy();
+}
+
+int64_t strix_pop_int(strix_vm *vm)
+{
+    int64_t integer;
+
+    return pop(vm).as_integer(integer) ? integer : 0;
+}
+
+double strix_pop_number(strix_vm *vm)
+{
+    Value value = pop(vm);
+
+    return value.is_number() ? value.as_double() : 0;
+}
+
+size_t strix_pop_string(strix_vm *vm, char *buffer, size_t size)
+{
+    Value value = pop(vm);
+
+    auto string    = value.get<String>();
+    bool is_string = string && string->is(ObjectType::String);
+
+    std::string formatted = is_string ? std::string() : value.to_string();
+    std::string_view data = is_string ? std::string_view(string->data) : std::string_view(formatted);
+
+    std::memcpy(buffer, data.data(), std::min(size, data.size()));
+
+    return data.size();
+}
+
+void strix_flush(strix_vm *vm)
+{
+    vm->vm->m_output.flush();
+}
@@ -1,5 +1,8 @@
 #include <iostream>
 #include <charconv>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "compiler.hpp"
 #include "scanner.hpp"
@@ -7,6 +10,8 @@
 #include "util/debug.hpp"
 #include "objects/string.hpp"
 #include "objects/tuple.hpp"
+#include "objects/map.hpp"
+#include "objects/jump_table.hpp"
 
 std::optional<Function> Compiler::compile()
 {
@@ -22,18 +27,200 @@ std::optional<Function> Compiler::compile()
     if(!m_entry_fn.name.empty())
     {
         emit_byte(OpCode::Constant, new Function(std::move(m_entry_fn)));
-        emit_byte(OpCode::Call, 0.0);
+        emit_operand(OpCode::Call, 0);
     }
 
     emit_bytes(OpCode::Return);
 
+    // skipped functions resolve globals against the finished table
+    if(m_globals)
+        *m_globals = m_identifiers[0];
+
     Function fn("static chunk");
 
-    fn.chunk = std::move(m_static_chunk);
+    *fn.chunk = std::move(m_static_chunk);
+    fn.slot_count = m_static_slots;
+
+    return fn;
+}
+
+std::optional<Function> Compiler::compile_module()
+{
+    advance();
+
+    while(!match(TokenType::Eof) && !m_had_error)
+        declaration();
+
+    if(m_had_error)
+        return std::nullopt;
+
+    std::vector<std::pair<std::string_view, Variable>> exports;
+
+    for(auto &[name, id] : m_identifiers[0])
+    {
+        // main is only the entry of a program so modules never run or export it
+        if(Variable *var = slot_of(id); var && name != "main")
+            exports.emplace_back(name, *var);
+    }
+
+    std::sort(exports.begin(), exports.end(), [](auto &a, auto &b)
+    {
+        return a.second.declaration < b.second.declaration;
+    });
+
+    // members point at the modules globals so importers see them change, reading one reads the global
+    for(auto &[name, var] : exports)
+    {
+        emit_byte(OpCode::Constant, new String(name));
+        emit_slot(OpCode::LoadAddr, var);
+    }
+
+    emit_operand(OpCode::ConstructMap, exports.size());
+
+    Variable slot = build_var(false);
+
+    emit_slot(OpCode::SetMem, slot);
+    emit_slot(OpCode::GetMem, slot);
+    emit_bytes(OpCode::Return);
+
+    Function fn("module");
+
+    *fn.chunk = std::move(m_static_chunk);
+    fn.slot_count = m_static_slots;
 
     return fn;
 }
 
+Compiler::Compiler(LazyBody &body) :
+    m_scanner(body.source),
+    m_errors(&body.errors)
+{
+    m_shared_globals  = body.globals.get();
+    m_global_cutoff   = body.cutoff;
+
+    m_scanner.seek(body.position);
+    m_current_token = body.start;
+}
+
+void Compiler::compile_body(LazyBody &body, std::string_view name)
+{
+    Compiler compiler(body);
+
+    Function compiled = name;
+
+    compiler.function_body(compiled, Variable{}, false, body.is_main);
+
+    if(compiler.m_had_error)
+        body.failed = true;
+    else
+        body.compiled = std::move(compiled);
+}
+
+bool Compiler::compile_lazy(Function &fn)
+{
+    auto &body = *fn.lazy;
+
+    // the body is shared by every copy of the function, including ones in vms on other threads
+    std::call_once(body.once, [&]
+    {
+        if(!body.compiled.has_value() && !body.failed)
+            compile_body(body, fn.name);
+
+        fmt::eprint(body.errors);
+    });
+
+    if(body.failed)
+        return false;
+
+    fn.chunk      = body.compiled->chunk;
+    fn.slot_count = body.compiled->slot_count;
+
+    fn.lazy.reset();
+
+    return true;
+}
+
+bool Compiler::compile_parallel(Function &program, unsigned thread_count)
+{
+    // skipped functions are only ever top level so they are all constants of the static chunk
+    std::vector<Function*> functions;
+
+    for(auto &constant : program.chunk->constants)
+    {
+        if(constant.type != ValueType::Object || constant.as.object->type() != ObjectType::Function)
+            continue;
+
+        auto fn = constant.get<Function>();
+
+        if(fn->lazy)
+            functions.push_back(fn);
+    }
+
+    // bodies only read the source and the finished globals table so each one gets a compiler of its own
+    std::atomic<size_t> next = 0;
+
+    auto work = [&]
+    {
+        for(size_t i; (i = next++) < functions.size();)
+            compile_body(*functions[i]->lazy, functions[i]->name);
+    };
+
+    std::vector<std::thread> workers;
+
+    for(unsigned i = 1; i < std::min<size_t>(thread_count, functions.size()); i++)
+        workers.emplace_back(work);
+
+    work();
+
+    for(auto &worker : workers)
+        worker.join();
+
+    bool ok = true;
+
+    for(auto fn : functions)
+        ok = compile_lazy(*fn) && ok;
+
+    return ok;
+}
+
+Function Compiler::split_entry(Function &program)
+{
+    Function entry("static chunk");
+
+    entry.slot_count = program.slot_count;
+
+    auto &bytes = program.chunk->bytes;
+    size_t size = bytes.size();
+
+    // compile always ends a program that has a main function with Constant main, Call 0, Return.
+    // main is never a constant anywhere else since calls to it by name go through its slot
+    auto is_entry = [&]
+    {
+        if(size < 3 || bytes[size-3].code != OpCode::Constant || bytes[size-2].code != OpCode::Call)
+            return false;
+
+        Value &constant = program.chunk->constants[bytes[size-3].constant];
+
+        return constant.type == ValueType::Object
+               && constant.as.object->type() == ObjectType::Function
+               && constant.get<Function>()->name == "main";
+    };
+
+    if(is_entry())
+    {
+        Bytes constant = bytes[size-3];
+
+        entry.chunk->set(OpCode::Constant, std::move(program.chunk->constants[constant.constant]), constant.line);
+        entry.chunk->bytes.push_back(bytes[size-2]);
+
+        bytes.erase(bytes.end()-3, bytes.end()-1);
+    }
+
+    entry.chunk->bytes.push_back(bytes.back());
+
+    return entry;
+}
+
 void Compiler::advance()
 {
     m_previous_token = m_current_token;
@@ -79,8 +266,12 @@ inline void Compiler::error_at(Token &token, std::string_view message)
 
     m_panic_mode = true;
 
-    fmt::eprint("[{}:{}] error on token '{}'\n\tmessage: {}\n",
-               token.line, token.column, token.lexeme, message);
+    constexpr std::string_view format = "[{}:{}] error on token '{}'\n\tmessage: {}\n";
+
+    if(m_errors)
+        *m_errors += fmt::format(format, token.line, token.column, token.lexeme, message);
+    else
+        fmt::eprint(format, token.line, token.column, token.lexeme, message);
 
     m_had_error = true;
 }
@@ -109,11 +300,20 @@ void Compiler::emit_byte(OpCode code, T &&value)
     current_chunk().set(code, std::forward<Value>(Value(value)), m_previous_token.line);
 }
 
+// for instructions that carry their operand directly instead of indexing the constant pool
+void Compiler::emit_operand(OpCode code, size_t operand)
+{
+    if(operand > MaxOperand)
+        return error("instruction operand is too large");
+
+    current_chunk().bytes.emplace_back(code, operand, m_previous_token.line);
+}
+
 size_t Compiler::emit_jmp(OpCode instruction)
 {
     auto &chunk = current_chunk();
 
-    emit_byte(instruction, 0.0);
+    emit_operand(instruction, 0);
 
     return chunk.bytes.size() - 1;
 }
@@ -121,25 +321,81 @@ size_t Compiler::emit_jmp(OpCode instruction)
 void Compiler::patch_jmp(size_t offset)
 {
     auto &bytes = current_chunk().bytes;
-    auto &value = current_chunk().constants[bytes[offset].constant];
 
-    double jmp = bytes.size() - offset - 1;
+    size_t jmp = bytes.size() - offset - 1;
 
-    value = Value(jmp);
+    if(jmp > MaxOperand)
+        return error("too much code to jump over");
+
+    bytes[offset].constant = jmp;
 }
 
 void Compiler::emit_rollback(size_t start)
 {
-    double amount = current_chunk().bytes.size() - start - 1;
-    emit_byte(OpCode::RollBack, amount);
+    size_t amount = current_chunk().bytes.size() - start - 1;
+
+    if(amount > MaxOperand)
+        return error("loop body is too large");
+
+    emit_operand(OpCode::RollBack, amount);
+}
+
+// code is the global form of the instruction (GetMem, SetMem or LoadAddr)
+// and is swapped for the local or upvalue form depending on where the variable lives
+void Compiler::emit_slot(OpCode code, Variable var)
+{
+    using enum OpCode;
+
+    switch(var.storage)
+    {
+        case Storage::Local:
+            code = code == GetMem ? GetLocal : code == SetMem ? SetLocal : LoadLocal;
+            break;
+        case Storage::Upvalue:
+            code = code == GetMem ? GetUpvalue : code == SetMem ? SetUpvalue : LoadUpvalue;
+            break;
+        // function names are constant and never subscripted so they are only ever read
+        case Storage::Callee:
+            return emit_bytes(GetCallee);
+        default:
+            break;
+    }
+
+    emit_operand(code, var.index);
 }
 
 inline void Compiler::number()
 {
-    double value;
-
     std::string_view lexeme = m_previous_token.lexeme;
 
+    if(m_previous_token.type == TokenType::Integer && lexeme.size() > 2 && (lexeme[1] == 'x' || lexeme[1] == 'b'))
+    {
+        uint64_t bits;
+
+        auto result = std::from_chars(lexeme.data()+2, lexeme.data()+lexeme.size(), bits, lexeme[1] == 'x' ? 16 : 2);
+
+        if(result.ec == std::errc::result_out_of_range)
+            return error("integer literal does not fit in 64 bits");
+        if(result.ptr != lexeme.data()+lexeme.size())
+            return error("invalid digit in integer literal");
+
+        // the full 64 bits are kept so 0xFFFFFFFFFFFFFFFF is -1
+        return emit_byte(OpCode::Constant, (int64_t)bits);
+    }
+
+    if(m_previous_token.type == TokenType::Integer)
+    {
+        int64_t value;
+
+        auto result = std::from_chars(lexeme.data(), lexeme.data()+lexeme.size(), value);
+
+        // literals too large for an int are kept as doubles
+        if(result.ec != std::errc::result_out_of_range)
+            return emit_byte(OpCode::Constant, value);
+    }
+
+    double value;
+
     std::from_chars(lexeme.data(), lexeme.data()+lexeme.size(), value);
 
     emit_byte(OpCode::Constant, value);
@@ -147,9 +403,6 @@ inline void Compiler::number()
 
 inline void Compiler::string()
 {
-    if(String::intern_strings.contains(m_current_token.lexeme))
-        return;
-
     emit_byte(OpCode::Constant, new String(m_previous_token.lexeme));
 }
 
@@ -174,6 +427,166 @@ void Compiler::fstring()
     advance();
 }
 
+void Compiler::map()
+{
+    uint32_t length{};
+
+    if(!check(TokenType::RightBrace))
+    {
+        do
+        {
+            // key
+            expression();
+
+            consume(TokenType::Colon, "expected token ':' after map key");
+
+            // value
+            expression();
+
+            length++;
+
+        } while(match(TokenType::Comma) && !check(TokenType::RightBrace));
+    }
+
+    consume(TokenType::RightBrace, "expected token '}' at the end of map literal");
+
+    emit_operand(OpCode::ConstructMap, length);
+}
+
+void Compiler::subscript()
+{
+    expression();
+
+    consume(TokenType::RightBracket, "expected token ']' after subscript");
+
+    emit_bytes(OpCode::GetIndex);
+}
+
+// yield evaluates to the value the coroutine is resumed with, a bare yield gives back nil
+void Compiler::yield()
+{
+    if(m_function_stack.empty())
+        return error("yield can only be used inside a function");
+
+    if(get_rule(m_current_token.type).prefix && m_current_token.line == m_previous_token.line)
+        parse_precedence(Precedence::Assignment);
+    else
+        emit_bytes(OpCode::Nil);
+
+    emit_bytes(OpCode::Yield);
+}
+
+// resume(coroutine) or resume(coroutine, value), evaluates to what the coroutine yields or returns next
+void Compiler::resume()
+{
+    consume(TokenType::LeftParen, "expected '(' after resume");
+
+    expression();
+
+    bool has_value = match(TokenType::Comma);
+
+    if(has_value)
+        expression();
+
+    consume(TokenType::RightParen, "expected matching ')'");
+
+    emit_operand(OpCode::Resume, has_value);
+}
+
+// modules export their globals as a map so a member is a subscript with the name as key
+void Compiler::member()
+{
+    consume(TokenType::Identifier, "expected identifier after '.'");
+
+    emit_byte(OpCode::Constant, new String(m_previous_token.lexeme));
+    emit_bytes(OpCode::GetIndex);
+}
+
+// members are read through the variables memory like subscripts so a module is not copied for every lookup,
+// a called member has its arguments pushed before the function like any other call
+void Compiler::member_var(Variable var)
+{
+    advance();
+    consume(TokenType::Identifier, "expected identifier after '.'");
+
+    auto name = new String(m_previous_token.lexeme);
+
+    uint8_t arg_count{};
+    bool called = match(TokenType::LeftParen);
+
+    if(called)
+        arg_count = parse_fn_params();
+
+    emit_slot(OpCode::LoadAddr, var);
+    emit_byte(OpCode::Constant, name);
+    emit_bytes(OpCode::GetIndex);
+
+    if(called)
+        emit_operand(OpCode::Call, arg_count);
+}
+
+// subscripts on variables work on the variables memory directly
+// so lookups and assignments never copy the whole container
+void Compiler::subscript_var(Variable var)
+{
+    using enum TokenType;
+
+    Token previous_token = m_previous_token;
+
+    bool can_assign = m_can_assign;
+
+    advance();
+
+    emit_slot(OpCode::LoadAddr, var);
+
+    expression();
+
+    consume(RightBracket, "expected token ']' after subscript");
+
+    bool compound = m_current_token.type > Star && m_current_token.type < Caret;
+
+    if(!(can_assign && check(Equal)) && !compound)
+        return emit_bytes(OpCode::GetIndex);
+
+    if(!var.is_mutable)
+        return error_at(previous_token, "constant variable cannot be modified");
+
+    // the parts of the loop work on copies of everything outside of it, so the write would be lost
+    if(var.function_depth < m_parallel_depth)
+        return error_at(previous_token, "a parallel for loop can only assign its own variables and reduce into the ones outside of it");
+
+    advance();
+
+    TokenType operator_type = m_previous_token.type;
+
+    if(operator_type == Equal)
+    {
+        expression();
+        return emit_bytes(OpCode::SetIndex);
+    }
+
+    // keeps the address and key around for the store after the current value is loaded
+    emit_bytes(OpCode::DupTwo, OpCode::GetIndex);
+
+    if(operator_type == PlusPlus || operator_type == MinusMinus)
+        emit_byte(OpCode::Constant, int64_t{1});
+    else
+        expression();
+
+    switch(operator_type)
+    {
+        case PlusEqual:
+        case PlusPlus:   emit_bytes(OpCode::Add);      break;
+        case MinusEqual:
+        case MinusMinus: emit_bytes(OpCode::Subtract); break;
+        case StarEqual:  emit_bytes(OpCode::Multiply); break;
+        case SlashEqual: emit_bytes(OpCode::Divide);   break;
+        default: break;
+    }
+
+    emit_bytes(OpCode::SetIndex);
+}
+
 inline void Compiler::grouping()
 {
     expression();
@@ -201,6 +614,11 @@ inline void Compiler::binary()
         case TokenType::Caret:        return emit_bytes(OpCode::Power);
         case TokenType::Percent:      return emit_bytes(OpCode::Mod);
         case TokenType::Slash:        return emit_bytes(OpCode::Divide);
+        case TokenType::Ampersand:    return emit_bytes(OpCode::BitAnd);
+        case TokenType::Pipe:         return emit_bytes(OpCode::BitOr);
+        case TokenType::Tilde:        return emit_bytes(OpCode::BitXor);
+        case TokenType::LessLess:     return emit_bytes(OpCode::ShiftLeft);
+        case TokenType::GreaterGreater: return emit_bytes(OpCode::ShiftRight);
         case TokenType::Or:           return emit_bytes(OpCode::Or);
         case TokenType::And:          return emit_bytes(OpCode::And);
         case TokenType::Is:           return emit_bytes(OpCode::TypeCmp);
@@ -219,6 +637,7 @@ void Compiler::unary()
     {
         case TokenType::Minus: return emit_bytes(OpCode::Negate);
         case TokenType::Bang:  return emit_bytes(OpCode::Not);
+        case TokenType::Tilde: return emit_bytes(OpCode::BitNot);
         default: return;
     }
 }
@@ -236,37 +655,39 @@ inline void Compiler::literal()
 
 void Compiler::fn_identifier(Identifier id)
 {
+    // a called native goes straight through the native table, only one used as a value becomes an object
+    if(auto native = std::get_if<NativeData>(&id))
+    {
+        auto &native_fn = builtin::natives()[native->index];
 
-#define GEN_NATIVE                                             \
-    auto native_fn = std::get<NativeFunction>(id);             \
-    emit_byte(OpCode::Constant, new NativeFunction(native_fn)) \
+        if(!match(TokenType::LeftParen))
+            return emit_byte(OpCode::Constant, new NativeFunction(native_fn));
 
-    // used for called identifiers
-    if(match(TokenType::LeftParen))
-    {
         uint8_t arg_count = parse_fn_params();
 
-        if(id.index() == 2)
-        {
-            GEN_NATIVE;
-        }
-        else
+        if(arg_count > native_fn.param_count)
+            return error(fmt::format("{} takes at most {} arguments", native_fn.name, (int)native_fn.param_count));
+
+        // the table index and the arg count share the operand, natives past what fits are called as objects
+        if(native->index > UINT8_MAX)
         {
-            uint16_t index = id_index(id);
-            emit_byte(OpCode::GetMem, index);
+            emit_byte(OpCode::Constant, new NativeFunction(native_fn));
+            return emit_operand(OpCode::Call, arg_count);
         }
 
-        emit_byte(OpCode::Call, (double)arg_count);
-    }
-    else if(id.index() == 1)
-    {
-        auto fn_data = std::get<FunctionData>(id);
-        emit_byte(OpCode::GetMem, fn_data.index);
+        return emit_operand(OpCode::CallNative, native->index << 8 | arg_count);
     }
-    else if(id.index() == 2)
+
+    // used for called identifiers
+    if(match(TokenType::LeftParen))
     {
-        GEN_NATIVE;
+        uint8_t arg_count = parse_fn_params();
+
+        emit_slot(OpCode::GetMem, *slot_of(id));
+        emit_operand(OpCode::Call, arg_count);
     }
+    else if(id.index() == 1)
+        emit_slot(OpCode::GetMem, *slot_of(id));
     else
         // im adding this because im 90% sure at some point this will help me catch a bug
         error("a fucky wucky happened in fn_identifier");
@@ -276,6 +697,12 @@ void Compiler::var_identifier(Compiler::Identifier id)
 {
     auto var = std::get<Variable>(id);
 
+    if(check(TokenType::LeftBracket))
+        return subscript_var(var);
+
+    if(check(TokenType::Dot))
+        return member_var(var);
+
     Token previous_token = m_previous_token;
 
     OpCode op;
@@ -308,12 +735,15 @@ void Compiler::var_identifier(Compiler::Identifier id)
     if(!var.is_mutable && assigned)
         return error_at(previous_token, "constant variable cannot be reassigned");
 
-    emit_byte(op, var.index);
+    if(assigned && var.function_depth < m_parallel_depth)
+        return error_at(previous_token, "a parallel for loop can only assign its own variables and reduce into the ones outside of it");
+
+    emit_slot(op, var);
 
     if(extra != OpCode::NoOp)
         emit_bytes(extra);
     if(get_mem)
-        emit_byte(OpCode::GetMem, var.index);
+        emit_slot(OpCode::GetMem, var);
 }
 
 void Compiler::identifier()
@@ -327,6 +757,10 @@ void Compiler::identifier()
 
     Identifier id = m_identifiers[scope_depth][identifier];
 
+    // variables are rewritten to how they are reached from the function being compiled
+    if(Variable *var = slot_of(id))
+        *var = resolve_access(*slot_of(m_identifiers[scope_depth][identifier]));
+
     if(id.index() != 0 || check(TokenType::LeftParen))
         fn_identifier(id);
     else
@@ -352,7 +786,7 @@ OpCode Compiler::mod_assignable(Variable var, bool &get_mem)
     {
         op = m_previous_token.type == PlusPlus ? OpCode::Increment : OpCode::Decrement;
         get_mem = false;
-        emit_byte(OpCode::GetMem, var.index);
+        emit_slot(OpCode::GetMem, var);
     }
     else
         expression();
@@ -371,7 +805,21 @@ void Compiler::end_scope()
     if(m_scope_depth == 0)
         return;
 
-    m_data_index -= m_identifiers[m_scope_depth].size();
+    auto &scope = m_identifiers[m_scope_depth];
+
+    uint16_t &slot_index = m_function_stack.empty() ? m_data_index : m_function_stack.back().slot_index;
+
+    slot_index -= scope.size();
+
+    // the slots are reused after this so closures still referring to them need their own copy,
+    // the outermost scope of a function is closed by its return instead
+    bool captured = std::any_of(scope.begin(), scope.end(), [this](auto &pair)
+    {
+        return slot_of(pair.second) && slot_of(pair.second)->is_captured;
+    });
+
+    if(captured && m_scope_depth != m_function_stack.back().scope_depth)
+        emit_operand(OpCode::CloseUpvalues, slot_index);
 
     m_scope_depth--;
 
@@ -408,6 +856,8 @@ void Compiler::statement()
     }
     else if(match(For))
         for_stmt();
+    else if(match(Parallel))
+        parallel_for_stmt();
     else if(match(SemiColon))
         return;
     else if(match(Continue) || match(Break))
@@ -424,6 +874,9 @@ void Compiler::continue_break_stmt()
         return error("break statement cannot be used outside of a loop");
 
     OpCode op = check_last(TokenType::Break) ? OpCode::Jump : OpCode::RollBack;
+
+    if(op == OpCode::Jump && m_parallel_depth != 0 && m_loop_jmps.size() == m_parallel_loop)
+        return error("break cannot be used in a parallel for loop");
     size_t jmp = -1;
 
     if(op == OpCode::RollBack)
@@ -499,6 +952,12 @@ void Compiler::while_stmt()
     m_loop_jmps.pop_back();
 }
 
+/*
+ * case bodies are compiled first and the dispatch is placed after them
+ * [value] SetMem Jump(dispatch) [body] Jump(end) ... dispatch: ... end:
+ * this way every label has been seen by the time the dispatch is emitted so
+ * switches over constant labels can dispatch with a single table lookup
+ */
 void Compiler::switch_stmt()
 {
     begin_scope();
@@ -506,16 +965,21 @@ void Compiler::switch_stmt()
     // switch value
     expression();
 
-    uint16_t data_index = m_data_index++;
+    // registered with the switch scope so the slot is released with it
+    Variable scrutinee = hidden_var("(switch)");
 
-    emit_byte(OpCode::SetMem, data_index);
+    emit_slot(OpCode::SetMem, scrutinee);
 
     consume(TokenType::LeftBrace, "expected token '{' after switch value");
 
+    size_t dispatch_jmp = emit_jmp(OpCode::Jump);
+
     // for all the exit jumps after the end of every branch
     std::vector<size_t> jmp_table;
 
-    int default_label = -1;
+    std::vector<SwitchCase> cases;
+
+    size_t default_target = -1;
 
     while(!check(TokenType::RightBrace) && !check(TokenType::Eof))
     {
@@ -524,34 +988,35 @@ void Compiler::switch_stmt()
         {
             consume(TokenType::Colon, "expected token ':' after case value");
 
-            if(default_label != -1)
+            if(default_target != -1)
                 return error("default label has been previously defined");
 
-            // jumps past default label body
-            size_t jmp = emit_jmp(OpCode::Jump);
-
-            default_label = current_chunk().bytes.size()-2;
+            default_target = current_chunk().bytes.size();
 
             statement();
 
             // jumps out of switch statement
             jmp_table.push_back(emit_jmp(OpCode::Jump));
 
-            patch_jmp(jmp);
-
             continue;
         }
 
-        emit_byte(OpCode::GetMem, data_index);
+        auto &bytes = current_chunk().bytes;
+
+        size_t label_start = bytes.size();
 
         // case value
         expression();
 
         consume(TokenType::Colon, "expected token ':' after case value");
 
-        emit_bytes(OpCode::Cmp);
+        // jumps in the label are relative so the instructions can be moved as a block
+        SwitchCase switch_case;
 
-        size_t jmp = emit_jmp(OpCode::Jif);
+        switch_case.label.assign(bytes.begin() + label_start, bytes.end());
+        bytes.erase(bytes.begin() + label_start, bytes.end());
+
+        switch_case.target = bytes.size();
 
         // body
         statement();
@@ -559,20 +1024,124 @@ void Compiler::switch_stmt()
         // jumps out of switch statement
         jmp_table.push_back(emit_jmp(OpCode::Jump));
 
-        patch_jmp(jmp);
+        cases.push_back(std::move(switch_case));
     }
 
-    if(default_label != -1)
-        emit_rollback(default_label);
+    patch_jmp(dispatch_jmp);
 
-    for(size_t jmp : jmp_table)
-        patch_jmp(jmp);
+    if(!emit_jump_table(cases, default_target, scrutinee))
+    {
+        // falls back to comparing against every label in order
+        for(auto &switch_case : cases)
+        {
+            auto &bytes = current_chunk().bytes;
 
-    end_scope();
-    consume(TokenType::RightBrace, "expected token '}' at the end of switch statement");
-}
+            emit_slot(OpCode::GetMem, scrutinee);
 
-void Compiler::for_stmt()
+            bytes.insert(bytes.end(), switch_case.label.begin(), switch_case.label.end());
+
+            emit_bytes(OpCode::Cmp);
+
+            size_t jmp = emit_jmp(OpCode::Jif);
+
+            // rollbacks land two instructions past their start
+            emit_rollback(switch_case.target - 2);
+
+            patch_jmp(jmp);
+        }
+
+        if(default_target != -1)
+            emit_rollback(default_target - 2);
+    }
+
+    for(size_t jmp : jmp_table)
+        patch_jmp(jmp);
+
+    end_scope();
+    consume(TokenType::RightBrace, "expected token '}' at the end of switch statement");
+}
+
+// emits a TableSwitch when the labels are a dense range of integers, a LookupSwitch when they are
+// any other numbers or strings and nothing if a label is not a constant
+bool Compiler::emit_jump_table(std::vector<SwitchCase> &cases, size_t default_target, Variable scrutinee)
+{
+    if(cases.empty())
+        return false;
+
+    auto &chunk = current_chunk();
+
+    std::vector<Value> labels;
+
+    bool dense = true;
+    int64_t low = 0, high = 0;
+
+    for(auto &switch_case : cases)
+    {
+        auto &label = switch_case.label;
+
+        bool negate = label.size() == 2 && label[1].code == OpCode::Negate;
+
+        if(label.empty() || label[0].code != OpCode::Constant || label.size() != 1 + negate)
+            return false;
+
+        Value value = chunk.constants[label[0].constant];
+
+        bool is_number = value.is_number();
+
+        if(negate && !is_number)
+            return false;
+        if(!is_number && !(value.type == ValueType::Object && value.as.object->is(ObjectType::String)))
+            return false;
+
+        if(negate && value.type == ValueType::Int)
+            value.as.integer = -value.as.integer;
+        else if(negate)
+            value.as.number = -value.as.number;
+
+        if(value.type == ValueType::Int)
+        {
+            int64_t integer = value.as.integer;
+
+            low  = labels.empty() ? integer : std::min(low, integer);
+            high = labels.empty() ? integer : std::max(high, integer);
+        }
+        else
+            dense = false;
+
+        labels.push_back(std::move(value));
+    }
+
+    emit_slot(OpCode::GetMem, scrutinee);
+
+    // the switch instruction is the last instruction of the dispatch so the end is right after it
+    size_t end = chunk.bytes.size() + 1;
+
+    auto table = new JumpTable(default_target == -1 ? end : default_target);
+
+    // only worth a direct table if at least half the range is used
+    dense = dense && (uint64_t)high - (uint64_t)low < labels.size() * 2;
+
+    if(dense)
+    {
+        table->low = low;
+        table->targets.assign((uint64_t)high - (uint64_t)low + 1, table->default_target);
+    }
+
+    // walks the labels backwards so that the first of any duplicate label wins like it would in a chain
+    for(size_t i = cases.size(); i-- > 0;)
+    {
+        if(dense)
+            table->targets[(uint64_t)labels[i].as.integer - (uint64_t)low] = cases[i].target;
+        else
+            table->cases.set(std::move(labels[i]), Value((int64_t)cases[i].target));
+    }
+
+    emit_byte(dense ? OpCode::TableSwitch : OpCode::LookupSwitch, table);
+
+    return true;
+}
+
+void Compiler::for_stmt()
 {
     m_loop_jmps.emplace_back();
 
@@ -580,24 +1149,62 @@ void Compiler::for_stmt()
 
     size_t body_start, body_jmp, inc_start, exit_jmp;
     bool range_based = false;
-    uint16_t index = -1;
+    Variable index{};
 
     // initializer clause
     if(check(TokenType::Identifier))
     {
         auto identifier = m_current_token.lexeme;
 
-        if(match(TokenType::Identifier) && match(TokenType::In))
+        if(match(TokenType::Identifier) && (check(TokenType::In) || check(TokenType::Comma)))
         {
-            Variable var = build_var(true);
+            std::string_view value_identifier;
+
+            if(match(TokenType::Comma))
+            {
+                consume(TokenType::Identifier, "expected identifier after token ','");
+                value_identifier = m_previous_token.lexeme;
+            }
 
-            index = var.index;
+            consume(TokenType::In, "expected token 'in'");
 
             expression();
 
-            set_identifier(var, identifier);
+            // collection based
+            if(!check(TokenType::DotDot))
+            {
+                // the iterate instruction expects these four slots to be contiguous
+                Variable collection = hidden_var("(collection)");
+                Variable cursor     = hidden_var("(cursor)");
+                Variable key        = build_var(true);
+                Variable value      = build_var(true);
+
+                set_identifier(key, identifier);
+                set_identifier(value, value_identifier.empty() ? "(value)" : value_identifier);
+
+                emit_slot(OpCode::SetMem, collection);
+                emit_byte(OpCode::Constant, int64_t{0});
+                emit_slot(OpCode::SetMem, cursor);
+
+                body_start = current_chunk().bytes.size()-2;
+                m_loop_starts[m_loop_jmps.size()-1] = body_start;
 
-            emit_byte(OpCode::SetMem, var.index);
+                emit_slot(OpCode::LoadAddr, collection);
+                emit_bytes(OpCode::Iterate);
+
+                exit_jmp = emit_jmp(OpCode::Jif);
+
+                goto body;
+            }
+
+            if(!value_identifier.empty())
+                return error("range based for loops only bind a single identifier");
+
+            index = build_var(true);
+
+            set_identifier(index, identifier);
+
+            emit_slot(OpCode::SetMem, index);
 
             consume(TokenType::DotDot, "expected token '..'");
 
@@ -607,7 +1214,7 @@ void Compiler::for_stmt()
             m_loop_starts[m_loop_jmps.size()-1] = body_start;
 
             // gets index
-            emit_byte(OpCode::GetMem, var.index);
+            emit_slot(OpCode::GetMem, index);
 
             // gets end range
             expression();
@@ -667,7 +1274,7 @@ body:
 
     if(range_based)
     {
-        emit_byte(OpCode::LoadAddr, index);
+        emit_slot(OpCode::LoadAddr, index);
         emit_bytes(OpCode::Increment);
     }
 
@@ -689,8 +1296,199 @@ body:
 #undef CONSUME
 }
 
+/*
+ * parallel for i in a..b into total, count <body>
+ * the body is compiled into a function over a part of the range that starts its own total and count at 0 and
+ * returns them. ParallelFor runs it over parts of the range on the worker pool and sums what they return,
+ * the sums are then added to the variables. [a] [b] [body] ParallelFor [LoadAddr total] Add
+ */
+void Compiler::parallel_for_stmt()
+{
+    consume(TokenType::For, "expected 'for' after parallel");
+    consume(TokenType::Identifier, "expected identifier after for");
+
+    std::string_view index_identifier = m_previous_token.lexeme;
+
+    consume(TokenType::In, "expected token 'in'");
+
+    expression();
+
+    consume(TokenType::DotDot, "parallel for loops only go over ranges");
+
+    bool inclusive = match(TokenType::Equal);
+
+    expression();
+
+    if(inclusive)
+    {
+        emit_byte(OpCode::Constant, int64_t{1});
+        emit_bytes(OpCode::Add);
+    }
+
+    consume(TokenType::Into, "expected 'into' followed by the variables the loop sums into");
+
+    std::vector<std::pair<std::string_view, Variable>> reductions;
+
+    do
+    {
+        consume(TokenType::Identifier, "expected identifier after into");
+
+        std::string_view name = m_previous_token.lexeme;
+
+        int scope_depth = resolve_var(name);
+
+        if(scope_depth == -1)
+            return error("use of unknown identifier");
+
+        auto var = std::get_if<Variable>(&m_identifiers[scope_depth][name]);
+
+        if(!var)
+            return error("a parallel for loop can only reduce into variables");
+        if(!var->is_mutable)
+            return error("constant variable cannot be reassigned");
+        if(var->function_depth < m_parallel_depth)
+            return error("a parallel for loop can only assign its own variables and reduce into the ones outside of it");
+
+        reductions.emplace_back(name, resolve_access(*var));
+
+        if(reductions.size() > UINT8_MAX)
+            return error("too many reductions");
+
+    } while(match(TokenType::Comma));
+
+    Function fn = std::string_view{"parallel for"};
+
+    uint8_t enclosing_depth = m_parallel_depth;
+    size_t enclosing_loop   = m_parallel_loop;
+
+    m_function_stack.push_back(FunctionState{.function = &fn, .scope_depth = m_scope_depth+1});
+
+    m_parallel_depth = m_function_stack.size();
+
+    begin_scope();
+
+    // the parameters are on the stack with the first one on top
+    Variable from = hidden_var("(from)");
+    emit_slot(OpCode::SetMem, from);
+
+    Variable to = hidden_var("(to)");
+    emit_slot(OpCode::SetMem, to);
+
+    fn.param_count = 2;
+
+    std::vector<Variable> partials;
+
+    for(auto &[name, var] : reductions)
+    {
+        Variable partial = build_var(true);
+
+        set_identifier(partial, name);
+
+        emit_byte(OpCode::Constant, int64_t{0});
+        emit_slot(OpCode::SetMem, partial);
+
+        partials.push_back(partial);
+    }
+
+    Variable index = build_var(true);
+
+    set_identifier(index, index_identifier);
+
+    emit_slot(OpCode::GetMem, from);
+    emit_slot(OpCode::SetMem, index);
+
+    m_loop_jmps.emplace_back();
+
+    m_parallel_loop = m_loop_jmps.size();
+
+    // the increment comes first so continue goes through it, the first iteration jumps over it
+    size_t first_jmp = emit_jmp(OpCode::Jump);
+
+    size_t body_start = current_chunk().bytes.size()-2;
+    m_loop_starts[m_loop_jmps.size()-1] = body_start;
+
+    emit_slot(OpCode::LoadAddr, index);
+    emit_bytes(OpCode::Increment);
+
+    patch_jmp(first_jmp);
+
+    emit_slot(OpCode::GetMem, index);
+    emit_slot(OpCode::GetMem, to);
+    emit_bytes(OpCode::Less);
+
+    size_t exit_jmp = emit_jmp(OpCode::Jif);
+
+    statement();
+
+    emit_rollback(body_start);
+
+    patch_jmp(exit_jmp);
+
+    for(auto i : m_loop_jmps[m_loop_jmps.size()-1])
+    {
+        if(i != -1)
+            patch_jmp(i);
+    }
+
+    m_loop_jmps.pop_back();
+
+    for(auto &partial : partials)
+        emit_slot(OpCode::GetMem, partial);
+
+    if(partials.size() > 1)
+    {
+        emit_byte(OpCode::Constant, new Tuple(partials.size()));
+        emit_bytes(OpCode::ConstructTuple);
+    }
+
+    emit_bytes(OpCode::Return);
+
+    end_scope();
+
+    m_function_stack.pop_back();
+
+    m_parallel_depth = enclosing_depth;
+    m_parallel_loop  = enclosing_loop;
+
+    if(m_had_error)
+        return;
+
+    OpCode code = fn.captures.empty() ? OpCode::Constant : OpCode::Closure;
+
+    emit_byte(code, new Function(std::move(fn)));
+    emit_bytes(OpCode::ParallelFor);
+
+    if(reductions.size() == 1)
+    {
+        emit_slot(OpCode::LoadAddr, reductions[0].second);
+        emit_bytes(OpCode::Add);
+
+        return;
+    }
+
+    begin_scope();
+
+    Variable sums = hidden_var("(sums)");
+
+    emit_slot(OpCode::SetMem, sums);
+
+    for(size_t i = 0; i < reductions.size(); i++)
+    {
+        emit_slot(OpCode::LoadAddr, sums);
+        emit_byte(OpCode::Constant, (int64_t)i);
+        emit_bytes(OpCode::GetIndex);
+        emit_slot(OpCode::LoadAddr, reductions[i].second);
+        emit_bytes(OpCode::Add);
+    }
+
+    end_scope();
+}
+
 void Compiler::return_stmt()
 {
+    if(m_parallel_depth != 0 && m_parallel_depth == m_function_stack.size())
+        return error("return cannot be used in a parallel for loop");
+
     if(!match(TokenType::SemiColon))
     {
         uint8_t return_count{};
@@ -724,6 +1522,8 @@ void Compiler::declaration()
         var_declaration(true, true, true);
     else if(match(TokenType::Fn))
         fn_declaration(false);
+    else if(match(TokenType::Import))
+        import_declaration();
     else
     {
 //        if(m_scope_depth == 0)
@@ -738,7 +1538,7 @@ void Compiler::declaration()
 void Compiler::multiple_var_declaration(bool is_const)
 {
     uint8_t id_count{};
-    uint16_t start_index = m_data_index;
+    Variable first{};
 
     do
     {
@@ -746,12 +1546,11 @@ void Compiler::multiple_var_declaration(bool is_const)
 
         std::string_view var_name = m_previous_token.lexeme;
 
-        Variable var
-        {
-            .depth      = m_scope_depth,
-            .is_mutable = !is_const,
-            .index      = m_data_index++,
-        };
+        // the slots are contiguous so SetFromTuple only needs the first
+        Variable var = build_var(!is_const);
+
+        if(id_count == 0)
+            first = var;
 
         set_identifier(var, var_name);
 
@@ -767,8 +1566,8 @@ void Compiler::multiple_var_declaration(bool is_const)
 
     expression();
 
-    emit_byte(OpCode::Constant, start_index);
-    emit_byte(OpCode::SetFromTuple, (uint16_t)id_count);
+    emit_slot(OpCode::LoadAddr, first);
+    emit_operand(OpCode::SetFromTuple, id_count);
 }
 
 void Compiler::var_declaration(bool consume_identifier = true, bool expect_value = true, bool allow_many = true)
@@ -778,12 +1577,7 @@ void Compiler::var_declaration(bool consume_identifier = true, bool expect_value
     if(match(TokenType::LeftParen))
         return multiple_var_declaration(is_const);
 
-    Variable var
-    {
-        .depth      = m_scope_depth,
-        .is_mutable = !is_const,
-        .index      = m_data_index++,
-    };
+    Variable var = build_var(!is_const);
 
     if(consume_identifier)
         consume(TokenType::Identifier, "expected identifier");
@@ -802,7 +1596,7 @@ void Compiler::var_declaration(bool consume_identifier = true, bool expect_value
         emit_bytes(OpCode::Nil);
     }
 
-    emit_byte(OpCode::SetMem, var.index);
+    emit_slot(OpCode::SetMem, var);
 
     set_identifier(var, var_name);
 
@@ -823,13 +1617,47 @@ void Compiler::fn_declaration(bool anon_fn)
 
     std::string_view id = is_named ? m_previous_token.lexeme : "fn()";
 
-    uint16_t index = m_data_index++;
+    // the slot belongs to the enclosing function so it is taken before this one is pushed,
+    // anonymous functions are only values so they get no slot or name
+    Variable var = is_named ? build_var(false) : Variable{};
 
     bool is_main = id == "main";
 
     Function fn = id;
 
-    m_function_stack.push_back(&fn);
+    // top level functions can only see globals and themselves so their bodies can wait for the first call
+    bool skipped = m_lazy && is_named && m_function_stack.empty() && m_scope_depth == 0
+                   && lazy_fn_declaration(fn, var, is_main);
+
+    if(!skipped)
+        function_body(fn, var, is_named, is_main);
+
+    if(m_had_error)
+        return;
+
+    // functions that capture nothing stay plain constants, only closures pay for creating upvalues
+    OpCode code = fn.captures.empty() ? OpCode::Constant : OpCode::Closure;
+
+    if(!is_named)
+        return emit_byte(code, new Function(std::move(fn)));
+    else if(is_main)
+        m_entry_fn = std::move(fn);
+    else
+    {
+        emit_byte(code, new Function(std::move(fn)));
+        emit_slot(OpCode::SetMem, var);
+    }
+}
+
+// compiles the signature and body into fn, registering its name in the enclosing scope if it has one
+void Compiler::function_body(Function &fn, Variable var, bool is_named, bool is_main)
+{
+    std::string_view id = fn.name;
+
+    m_function_stack.push_back(FunctionState{.function = &fn, .scope_depth = m_scope_depth+1});
+
+    if(is_named && var.storage == Storage::Local)
+        m_function_stack.back().self = var;
 
     begin_scope();
 
@@ -852,44 +1680,150 @@ void Compiler::fn_declaration(bool anon_fn)
         } while(match(TokenType::Comma));
     }
 
-    m_scope_depth--;
-
-    FunctionData fn_data =
+    if(is_named)
     {
-        .param_count = fn.param_count,
-        .index = index,
-    };
+        m_scope_depth--;
 
-    set_identifier(fn_data, id);
+        FunctionData fn_data =
+        {
+            .param_count = fn.param_count,
+            .var = var,
+        };
 
-    m_scope_depth++;
+        set_identifier(fn_data, id);
+
+        m_scope_depth++;
+    }
 
     consume(TokenType::RightParen, "expected token matching ')' token");
 
+    // single expression functions return the expression
     if(match(TokenType::Equal))
+    {
         expression();
+        emit_bytes(OpCode::Return);
+    }
     else
     {
         consume(TokenType::LeftBrace, "expected token '{' or '=' after function signature");
 
         block();
-    }
 
-    emit_bytes(OpCode::Nil, OpCode::Return);
+        emit_bytes(OpCode::Nil, OpCode::Return);
+    }
 
     end_scope();
 
     m_function_stack.pop_back();
+}
 
-    if(!is_named)
-        return emit_byte(OpCode::Constant, new Function(std::move(fn)));
-    else if(is_main)
-        m_entry_fn = std::move(fn);
-    else
+// reads only the signature and skips over the body by matching braces, returns false without consuming
+// anything if the function is a single expression since there is no cheap way to find where it ends
+bool Compiler::lazy_fn_declaration(Function &fn, Variable var, bool is_main)
+{
+    Token start = m_current_token;
+    Scanner::Position position = m_scanner.position();
+
+    consume(TokenType::LeftParen, "expected token '(' after function identifier");
+
+    if(!check(TokenType::RightParen))
+    {
+        if(is_main)
+        {
+            error("main function does not take any arguments");
+            return true;
+        }
+
+        do
+        {
+            consume(TokenType::Identifier, "expected identifier");
+
+            fn.param_count++;
+
+            if(fn.param_count > max_of(fn.param_count))
+            {
+                error("exceeded maximum limit of parameters");
+                return true;
+            }
+
+        } while(match(TokenType::Comma));
+    }
+
+    consume(TokenType::RightParen, "expected token matching ')' token");
+
+    if(!check(TokenType::LeftBrace))
+    {
+        m_scanner.seek(position);
+        m_current_token = start;
+        fn.param_count  = 0;
+        return false;
+    }
+
+    FunctionData fn_data =
+    {
+        .param_count = fn.param_count,
+        .var = var,
+    };
+
+    set_identifier(fn_data, fn.name);
+
+    if(!m_globals)
+        m_globals = std::make_shared<IDTable>();
+
+    // built in place since the once flag in a body cannot be moved
+    fn.lazy = std::make_shared<LazyBody>();
+
+    fn.lazy->source   = m_scanner.source();
+    fn.lazy->globals  = m_globals;
+    fn.lazy->cutoff   = m_global_count;
+    fn.lazy->start    = start;
+    fn.lazy->position = position;
+    fn.lazy->is_main  = is_main;
+
+    advance();
+
+    // braces inside format strings are not tokens so counting them is enough
+    for(size_t depth = 1; depth > 0; advance())
     {
-        emit_byte(OpCode::Constant, new Function(std::move(fn)));
-        emit_byte(OpCode::SetMem, index);
+        if(check(TokenType::Eof))
+        {
+            error_at(m_current_token, "expected '}' at the end of block");
+            return true;
+        }
+
+        if(check(TokenType::LeftBrace))
+            depth++;
+        else if(check(TokenType::RightBrace))
+            depth--;
+        else if(check(TokenType::FStringEnd))
+            m_state = ParseState::None;
     }
+
+    // the body compiler sees nothing from the token after the closing brace on so recovering from an error cannot
+    // run into the declarations after it, ending there rather than at the brace keeps the line of the trailing return
+    std::string_view &source = fn.lazy->source;
+
+    source = source.substr(0, m_current_token.lexeme.data() - source.data());
+
+    return true;
+}
+
+// binds the exports of a module to a constant global named after it
+void Compiler::import_declaration()
+{
+    if(m_scope_depth != 0 || !m_function_stack.empty())
+        return error("modules can only be imported at the top level");
+
+    consume(TokenType::Identifier, "expected module name after import");
+
+    std::string_view name = m_previous_token.lexeme;
+
+    Variable var = build_var(false);
+
+    emit_byte(OpCode::Import, new String(name));
+    emit_slot(OpCode::SetMem, var);
+
+    set_identifier(var, name);
 }
 
 void Compiler::anon_fn()
@@ -897,17 +1831,106 @@ void Compiler::anon_fn()
     fn_declaration(true);
 }
 
-int Compiler::resolve_var(std::string_view identifier) const
+int Compiler::resolve_var(std::string_view identifier)
 {
-    for(int i = m_scope_depth; i >= 0; i--)
+    for(int i = m_scope_depth; i > 0; i--)
     {
         if(m_identifiers[i].contains(identifier))
             return i;
     }
 
+    auto global = m_identifiers[0].find(identifier);
+
+    // a skipped body copies only the globals it uses out of the finished table, it is shared by every body
+    if(global == m_identifiers[0].end() && m_shared_globals)
+    {
+        auto shared = m_shared_globals->find(identifier);
+
+        if(shared != m_shared_globals->end())
+            global = m_identifiers[0].emplace(*shared).first;
+    }
+
+    if(global != m_identifiers[0].end())
+    {
+        Variable *var = slot_of(global->second);
+
+        if(!var || var->declaration < m_global_cutoff)
+            return 0;
+    }
+
     return -1;
 }
 
+// gives the variable as it is reached from the function currently being compiled
+Compiler::Variable Compiler::resolve_access(Variable &var)
+{
+    uint8_t function_depth = m_function_stack.size();
+
+    if(var.storage == Storage::Global || var.function_depth == function_depth)
+        return var;
+
+    Variable access = var;
+
+    // a local function naming itself is the function of its own frame, closures inside it capture that instead
+    // of the slot it is stored in since the closed upvalue would hold the function holding the upvalue
+    if(auto &owner = m_function_stack[var.function_depth]; owner.self && owner.self->index == var.index)
+    {
+        if(var.function_depth + 1 == function_depth)
+        {
+            access.storage = Storage::Callee;
+            return access;
+        }
+
+        Variable callee = var;
+
+        callee.function_depth = var.function_depth + 1;
+        callee.index          = Capture::Callee;
+
+        access.storage = Storage::Upvalue;
+        access.index   = resolve_upvalue(function_depth, callee);
+
+        return access;
+    }
+
+    access.storage = Storage::Upvalue;
+    access.index   = resolve_upvalue(function_depth, var);
+
+    var.is_captured = true;
+
+    return access;
+}
+
+// adds the variable to the captures of the function at function_depth and every function between it and the owner
+uint16_t Compiler::resolve_upvalue(uint8_t function_depth, const Variable &var)
+{
+    Capture capture =
+    {
+        .is_local = var.function_depth == function_depth - 1,
+        .index    = var.index,
+    };
+
+    if(!capture.is_local)
+        capture.index = resolve_upvalue(function_depth - 1, var);
+
+    auto &captures = m_function_stack[function_depth - 1].function->captures;
+
+    for(size_t i = 0; i < captures.size(); i++)
+    {
+        if(captures[i].is_local == capture.is_local && captures[i].index == capture.index)
+            return i;
+    }
+
+    if(captures.size() > MaxOperand)
+    {
+        error("too many variables captured by a closure");
+        return 0;
+    }
+
+    captures.push_back(capture);
+
+    return captures.size() - 1;
+}
+
 void Compiler::set_identifier(Identifier id, std::string_view var_name)
 {
     IDTable &vars = m_identifiers[m_scope_depth];
@@ -915,6 +1938,9 @@ void Compiler::set_identifier(Identifier id, std::string_view var_name)
     if(vars.contains(var_name))
         return error("identifier is already defined in this scope");
 
+    if(Variable *var = slot_of(id); var && m_scope_depth == 0)
+        var->declaration = m_global_count++;
+
     vars.emplace(var_name, id);
 }
 
@@ -995,7 +2021,7 @@ uint8_t Compiler::parse_fn_params()
 inline void Compiler::call()
 {
     uint8_t arg_count = parse_fn_params();
-    emit_byte(OpCode::Call, (double)arg_count);
+    emit_operand(OpCode::Call, arg_count);
 }
 
 inline bool Compiler::check(TokenType type) const
@@ -1016,35 +2042,73 @@ bool Compiler::match(TokenType type)
     return true;
 }
 
+// takes the next slot of the current frame, or a static slot outside of functions
+uint16_t Compiler::next_slot()
+{
+    if(m_function_stack.empty())
+    {
+        m_static_slots = std::max<uint16_t>(m_static_slots, m_data_index + 1);
+        return m_data_index++;
+    }
+
+    auto &state = m_function_stack.back();
+
+    // the last index marks captures of the function itself
+    if(state.slot_index == Capture::Callee)
+        error("too many variables in one function");
+
+    state.function->slot_count = std::max<uint16_t>(state.function->slot_count, state.slot_index + 1);
+
+    return state.slot_index++;
+}
+
 Compiler::Variable Compiler::build_var(bool is_mutable)
 {
     return Variable
     {
         .depth = m_scope_depth,
         .is_mutable = is_mutable,
-        .index = m_data_index++
+        .index = next_slot(),
+        .storage = m_function_stack.empty() ? Storage::Global : Storage::Local,
+        .function_depth = (uint8_t)m_function_stack.size(),
     };
 }
 
+// reserves a slot that scripts cannot name but that is still released with its scope
+Compiler::Variable Compiler::hidden_var(std::string_view name)
+{
+    Variable var = build_var(true);
+
+    set_identifier(var, name);
+
+    return var;
+}
+
 inline Chunk& Compiler::current_chunk()
 {
-    return m_function_stack.empty() ? m_static_chunk : m_function_stack.back()->chunk;
+    return m_function_stack.empty() ? m_static_chunk : *m_function_stack.back().function->chunk;
 }
 
-inline uint16_t Compiler::id_index(Compiler::Identifier id) const
+// the slot an identifier is stored in, native functions have none
+Compiler::Variable* Compiler::slot_of(Identifier &id)
 {
-    bool is_var = id.index() == 0;
-    return is_var ? std::get<Variable>(id).index : std::get<FunctionData>(id).index;
+    if(auto var = std::get_if<Variable>(&id))
+        return var;
+    if(auto fn_data = std::get_if<FunctionData>(&id))
+        return &fn_data->var;
+    return nullptr;
 }
 
 const Compiler::ParseRule Compiler::m_rules[] =
 {
         {&Compiler::grouping, &Compiler::call, Precedence::Call}, //leftparen
         {nullptr,     nullptr,   Precedence::None}, // rightparen
-        {nullptr,     nullptr,   Precedence::None}, // leftbrace
+        {&Compiler::map,     nullptr,   Precedence::None}, // leftbrace
         {nullptr,     nullptr,   Precedence::None}, // rightbrace
+        {nullptr, &Compiler::subscript, Precedence::Call}, // leftbracket
+        {nullptr,     nullptr,   Precedence::None}, // rightbracket
         {nullptr,     nullptr,   Precedence::None}, // comma
-        {nullptr,     nullptr,   Precedence::None}, // dot
+        {nullptr, &Compiler::member, Precedence::Call}, // dot
         {nullptr,     nullptr,   Precedence::None}, // dotdot
         {&Compiler::unary, &Compiler::binary,   Precedence::Term}, // minus
         {nullptr, &Compiler::binary,   Precedence::Term}, // plus
@@ -1060,6 +2124,11 @@ const Compiler::ParseRule Compiler::m_rules[] =
         {nullptr, nullptr, Precedence::None}, // minus minus
         {nullptr, &Compiler::binary, Precedence::Primary}, // caret
         {nullptr, &Compiler::binary,   Precedence::Factor}, // percent
+        {nullptr, &Compiler::binary,   Precedence::BitAnd}, // ampersand
+        {nullptr, &Compiler::binary,   Precedence::BitOr}, // pipe
+        {&Compiler::unary, &Compiler::binary,   Precedence::BitXor}, // tilde
+        {nullptr, &Compiler::binary,   Precedence::Shift}, // lessless
+        {nullptr, &Compiler::binary,   Precedence::Shift}, // greatergreater
         {&Compiler::unary,     nullptr,   Precedence::None}, // bang
         {nullptr, &Compiler::binary,   Precedence::Equality}, // bangequal
         {nullptr,     nullptr,   Precedence::None}, // equal
@@ -1073,6 +2142,7 @@ const Compiler::ParseRule Compiler::m_rules[] =
         {&Compiler::fstring, nullptr,        Precedence::None}, // fstringstart
         {nullptr, nullptr, Precedence::None}, // fstringend
         {&Compiler::number,     nullptr,     Precedence::None}, // number
+        {&Compiler::number,     nullptr,     Precedence::None}, // integer
         {nullptr,     &Compiler::binary,   Precedence::And}, //  and
         {nullptr,     &Compiler::binary,   Precedence::And}, // is
         {nullptr, nullptr, Precedence::None}, // in
@@ -1096,6 +2166,11 @@ const Compiler::ParseRule Compiler::m_rules[] =
         {nullptr,     nullptr,   Precedence::None}, // continue
         {nullptr,     nullptr,   Precedence::None}, // break
         {nullptr,     nullptr,   Precedence::None}, // default
+        {nullptr,     nullptr,   Precedence::None}, // import
+        {&Compiler::yield,  nullptr, Precedence::None}, // yield
+        {&Compiler::resume, nullptr, Precedence::None}, // resume
+        {nullptr,     nullptr,   Precedence::None}, // parallel
+        {nullptr,     nullptr,   Precedence::None}, // into
         {nullptr,     nullptr,   Precedence::None}, // error
         {nullptr,     nullptr,   Precedence::None}, // eof
 };
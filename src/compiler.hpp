@@ -3,6 +3,9 @@
 #include <string_view>
 #include <array>
 #include <variant>
+#include <memory>
+#include <optional>
+#include <mutex>
 
 #include "types/chunk.hpp"
 #include "scanner.hpp"
@@ -20,6 +23,10 @@ enum class Precedence : uint8_t
     And,
     Equality,
     Comparison,
+    BitOr,
+    BitXor,
+    BitAnd,
+    Shift,
     Term,
     Factor,
     Unary,
@@ -36,25 +43,57 @@ enum class ParseState : uint8_t
 class Compiler
 {
 public:
-    Compiler(std::string_view source)
+    // a lazy compiler skips the bodies of top level functions, they are compiled on their first call instead
+    Compiler(std::string_view source, bool lazy = false)
     :
-            m_scanner(source)
+            m_scanner(source),
+            m_lazy(lazy)
     {
+        declare_natives();
+    }
 
-#define REGISTER(name, params, fn) m_identifiers[0][name] = NativeFunction(name, params, fn)
-
-        REGISTER("panic", 1, builtin::panic);
-        REGISTER("input", 1, builtin::input);
-        REGISTER("print", 1, builtin::print);
-        REGISTER("println", 1, builtin::println);
-
-#undef  REGISTER
+    // compiles the source as it is read from fd so compiling can start before all of it has arrived
+    explicit Compiler(int fd)
+    :
+            m_scanner(fd)
+    {
+        declare_natives();
     }
 
     std::optional<Function> compile();
 
+    // compiles the source as a module, the program returns a map of its globals by name instead of calling main.
+    // the map is also kept in the last global slot so importing the module again does not rerun it
+    std::optional<Function> compile_module();
+
+    // compiles the body of a function a lazy compiler skipped, false if it has a compile error
+    static bool compile_lazy(Function &fn);
+
+    // compiles every body a lazy compiler skipped in program across up to thread_count threads,
+    // the result is the same as compiling eagerly and errors are reported in declaration order
+    static bool compile_parallel(Function &program, unsigned thread_count);
+
+    // splits the call to main off the end of a compiled program so the declarations before it can run on their own,
+    // returns a program over the same globals that only calls main
+    static Function split_entry(Function &program);
+
 private:
 
+    friend struct LazyBody;
+
+    explicit Compiler(LazyBody &body);
+
+    // compiles a skipped body into body.compiled, or marks it as failed
+    static void compile_body(LazyBody &body, std::string_view name);
+
+    void declare_natives()
+    {
+        auto &natives = builtin::natives();
+
+        for(size_t i = 0; i < natives.size(); i++)
+            m_identifiers[0][natives[i].name] = NativeData{(uint16_t)i};
+    }
+
     Scanner m_scanner;
 
     Token m_previous_token;
@@ -65,30 +104,68 @@ private:
 
     bool m_had_error = false;
     bool m_panic_mode = false;
+
+    // errors are collected here instead of printed when set
+    std::string *m_errors = nullptr;
     bool m_can_assign;
 
     // used for program entry (main function) will be called at the end of the static chunk
     Function m_entry_fn;
 
-    // used to determine which chunk the bytes will be written into
-    std::vector<Function*> m_function_stack;
-
-    ParseState m_state = ParseState::None;
+    // globals and variables in top level blocks live at fixed slots, function locals are relative to their frame
+    // and locals of an enclosing function are reached through the closures upvalues
+    enum class Storage : uint8_t
+    {
+        Global,
+        Local,
+        Upvalue,
+        // the function being compiled named by itself, read from its call frame
+        Callee,
+    };
 
     struct Variable
     {
         size_t depth;
         bool is_mutable;
         uint16_t index;
+        Storage storage = Storage::Global;
+        // nesting level of the function that owns the slot, 0 for the static chunk
+        uint8_t function_depth = 0;
+        // set once a closure refers to the variable so its upvalue is closed when the scope ends
+        bool is_captured = false;
+        // declaration order of globals, lazily compiled functions only see the globals declared before them
+        uint32_t declaration = 0;
     };
 
+    struct FunctionState
+    {
+        Function *function;
+        // scope depth of the functions parameters
+        size_t scope_depth;
+        // counter for the next free slot in the functions frame
+        uint16_t slot_index = 0;
+        // the local the function is declared into if it has a name
+        std::optional<Variable> self;
+    };
+
+    // used to determine which chunk the bytes will be written into
+    std::vector<FunctionState> m_function_stack;
+
+    ParseState m_state = ParseState::None;
+
     struct FunctionData
     {
         uint8_t param_count;
+        Variable var;
+    };
+
+    struct NativeData
+    {
+        // where the native is in builtin::natives()
         uint16_t index;
     };
 
-    using Identifier = std::variant<Variable, FunctionData, NativeFunction>;
+    using Identifier = std::variant<Variable, FunctionData, NativeData>;
 
     using IDTable = std::unordered_map<std::string_view, Identifier>;
 
@@ -96,8 +173,24 @@ private:
     std::vector<IDTable> m_identifiers { IDTable() };
     size_t m_scope_depth = 0;
 
+    bool m_lazy = false;
+    // filled with the globals once compilation finishes, shared with every function that was skipped
+    std::shared_ptr<IDTable> m_globals;
+    uint32_t m_global_count = 0;
+    // globals declared at or after this are not visible, used when compiling a skipped function
+    uint32_t m_global_cutoff = UINT32_MAX;
+    // the globals of the whole program when compiling a skipped body, read only
+    const IDTable *m_shared_globals = nullptr;
+
     // counter for data index that mirrors the vms arrays
     uint16_t m_data_index = 0;
+    // the most static slots in use at once, the vm reserves these before any frame
+    uint16_t m_static_slots = 0;
+
+    // the function depth of the innermost parallel for body and the loop depth of its loop, 0 outside of one.
+    // the body runs on copies of everything outside of it so it can only assign its own locals
+    uint8_t m_parallel_depth = 0;
+    size_t m_parallel_loop = 0;
 
     // elements are the start of the loop at the current loop depth
     std::array<size_t, 50> m_loop_starts;
@@ -105,6 +198,14 @@ private:
     // in the second its the index of the byte that must be updated in the chunk
     std::vector<std::vector<size_t>> m_loop_jmps;
 
+    struct SwitchCase
+    {
+        // the instructions for the case label, compiled in place then moved into the dispatch block
+        std::vector<Bytes> label;
+        // instruction index of the case body
+        size_t target;
+    };
+
     typedef void(Compiler::*ParseFN)();
 
     struct ParseRule
@@ -133,18 +234,32 @@ private:
     template<typename T>
     void emit_byte(OpCode code, T &&value);
 
+    void emit_operand(OpCode code, size_t operand);
+
     size_t emit_jmp(OpCode instruction);
 
     void patch_jmp(size_t offset);
 
     void emit_rollback(size_t start);
 
+    void emit_slot(OpCode code, Variable var);
+
     void number();
 
     void string();
 
     void fstring();
 
+    void map();
+
+    void subscript();
+
+    void member();
+
+    void member_var(Variable var);
+
+    void subscript_var(Variable var);
+
     void grouping();
 
     void binary();
@@ -153,6 +268,10 @@ private:
 
     void literal();
 
+    void yield();
+
+    void resume();
+
     void fn_identifier(Identifier id);
 
     void var_identifier(Identifier id);
@@ -179,8 +298,12 @@ private:
 
     void switch_stmt();
 
+    bool emit_jump_table(std::vector<SwitchCase> &cases, size_t default_target, Variable scrutinee);
+
     void for_stmt();
 
+    void parallel_for_stmt();
+
     void return_stmt();
 
     void declaration();
@@ -191,9 +314,19 @@ private:
 
     void fn_declaration(bool anon_fn = false);
 
+    void import_declaration();
+
+    void function_body(Function &fn, Variable var, bool is_named, bool is_main);
+
+    bool lazy_fn_declaration(Function &fn, Variable var, bool is_main);
+
     void anon_fn();
 
-    int resolve_var(std::string_view identifier) const;
+    int resolve_var(std::string_view identifier);
+
+    Variable resolve_access(Variable &var);
+
+    uint16_t resolve_upvalue(uint8_t function_depth, const Variable &var);
 
     void set_identifier(Identifier id, std::string_view var_name);
 
@@ -211,9 +344,37 @@ private:
 
     bool match(TokenType type);
 
+    uint16_t next_slot();
+
     Compiler::Variable build_var(bool is_mutable);
 
+    Compiler::Variable hidden_var(std::string_view name);
+
     Chunk& current_chunk();
 
-    uint16_t id_index(Identifier id) const;
+    static Variable* slot_of(Identifier &id);
+};
+
+/*
+ * a top level function whose body a lazy compiler skipped, compiled on its first call.
+ * every copy of the function shares it so the body is only compiled once
+ */
+struct LazyBody
+{
+    std::string_view source;
+    std::shared_ptr<Compiler::IDTable> globals;
+    // the number of globals declared before the function
+    uint32_t cutoff;
+    // the '(' starting the signature and the scanner position right after it
+    Token start;
+    Scanner::Position position;
+    bool is_main;
+
+    std::optional<Function> compiled;
+    bool failed = false;
+    // printed when the body is installed so bodies compiled on other threads still report in order
+    std::string errors;
+
+    // the first call compiles the body and reports its errors, every later one only reads it
+    std::once_flag once;
 };
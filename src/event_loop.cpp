@@ -0,0 +1,488 @@
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "event_loop.hpp"
+#include "vm.hpp"
+#include "objects/coroutine.hpp"
+#include "objects/string.hpp"
+#include "objects/tuple.hpp"
+
+namespace
+{
+    constexpr size_t ReadSize = 64 * 1024;
+
+    // true if the descriptor has something to read or room to write without waiting
+    bool ready(int fd, short events)
+    {
+        pollfd entry{fd, events, 0};
+
+        return ::poll(&entry, 1, 0) > 0;
+    }
+
+    void wait_for(int fd, short events)
+    {
+        pollfd entry{fd, events, 0};
+
+        while(::poll(&entry, 1, -1) < 0 && errno == EINTR)
+            ;
+    }
+
+    // writing to a socket or pipe whose other end is closed fails with EPIPE instead of raising SIGPIPE, which
+    // would end the process. the disposition of SIGPIPE belongs to the program embedding strix so it is left alone:
+    // sockets are sent to without the signal and for anything else it is blocked on this thread during the write
+    // and taken off again if the write raised it
+    ssize_t write_quietly(int fd, const char *data, size_t size)
+    {
+        ssize_t count = ::send(fd, data, size, MSG_NOSIGNAL);
+
+        if(count != -1 || errno != ENOTSOCK)
+            return count;
+
+        sigset_t pipe_signal, pending, previous;
+
+        sigemptyset(&pipe_signal);
+        sigaddset(&pipe_signal, SIGPIPE);
+
+        // one that was already waiting is not ours to take
+        sigpending(&pending);
+        bool was_pending = sigismember(&pending, SIGPIPE);
+
+        pthread_sigmask(SIG_BLOCK, &pipe_signal, &previous);
+
+        count = ::write(fd, data, size);
+
+        int error = errno;
+
+        if(count == -1 && error == EPIPE && !was_pending)
+        {
+            timespec now{};
+            sigtimedwait(&pipe_signal, nullptr, &now);
+        }
+
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+        errno = error;
+
+        return count;
+    }
+
+    bool would_block()
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+
+    // looks up host for a tcp socket, the first address that resolves is used
+    bool resolve(const std::string &host, int64_t port, sockaddr_storage &address, socklen_t &length)
+    {
+        if(port < 0 || port > UINT16_MAX)
+            return false;
+
+        addrinfo hints{};
+
+        hints.ai_family   = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags    = AI_NUMERICSERV;
+
+        addrinfo *result;
+
+        std::string service = std::to_string(port);
+
+        if(getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0)
+            return false;
+
+        std::memcpy(&address, result->ai_addr, result->ai_addrlen);
+        length = result->ai_addrlen;
+
+        freeaddrinfo(result);
+
+        return true;
+    }
+}
+
+EventLoop::EventLoop() :
+    m_epoll(epoll_create1(EPOLL_CLOEXEC))
+{}
+
+EventLoop::~EventLoop()
+{
+    if(m_epoll != -1)
+        ::close(m_epoll);
+}
+
+void EventLoop::queue(std::shared_ptr<Fiber> &&fiber, Value &&argument)
+{
+    m_ready.push_back({std::move(fiber), std::move(argument)});
+}
+
+void EventLoop::perform(VM &vm, int fd, Direction direction, Attempt &&attempt)
+{
+    if(auto result = attempt())
+    {
+        vm.m_stack.push_back(std::move(result.value()));
+        return;
+    }
+
+    short events = direction == Direction::Read ? POLLIN : POLLOUT;
+
+    // only a call the loop is running can be set aside, anything else has to wait here
+    if(!vm.m_fiber || !vm.m_fiber->async || m_epoll == -1)
+    {
+        while(true)
+        {
+            wait_for(fd, events);
+
+            if(auto result = attempt())
+            {
+                vm.m_stack.push_back(std::move(result.value()));
+                return;
+            }
+        }
+    }
+
+    Watch &watch = m_watches[fd];
+
+    auto &waiter = direction == Direction::Read ? watch.reader : watch.writer;
+
+    if(waiter.has_value())
+    {
+        vm.runtime_error("another async call is already waiting on this descriptor");
+        return;
+    }
+
+    waiter = Waiter{vm.m_fiber, std::move(attempt)};
+
+    if(!update(fd, watch))
+    {
+        waiter.reset();
+        update(fd, watch);
+
+        vm.m_stack.emplace_back(nullptr);
+        return;
+    }
+
+    m_waiting++;
+    m_parked = true;
+
+    vm.suspend(Value(nullptr), false);
+}
+
+void EventLoop::forget(int fd)
+{
+    auto it = m_watches.find(fd);
+
+    if(it == m_watches.end())
+        return;
+
+    for(auto waiter : {&it->second.reader, &it->second.writer})
+    {
+        if(!waiter->has_value())
+            continue;
+
+        m_ready.push_back({std::move(waiter->value().fiber), Value(nullptr)});
+        m_waiting--;
+    }
+
+    if(it->second.registered)
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+
+    m_watches.erase(it);
+}
+
+InterpretResult EventLoop::run(VM &vm)
+{
+    while(!m_ready.empty() || m_waiting > 0)
+    {
+        poll(m_ready.empty() ? -1 : 0);
+
+        // only the calls that were ready before polling run this round so descriptors are checked in between
+        for(size_t count = m_ready.size(); count > 0; count--)
+        {
+            Ready next = std::move(m_ready.front());
+            m_ready.pop_front();
+
+            m_parked = false;
+
+            if(vm.drive(next.fiber, std::move(next.value)) != InterpretResult::Ok)
+                return vm.m_state;
+
+            // a call that suspended without waiting on a descriptor yielded, it goes to the back of the queue
+            if(next.fiber->status == Fiber::Status::Suspended && !m_parked)
+                m_ready.push_back({std::move(next.fiber), Value(nullptr)});
+        }
+    }
+
+    return InterpretResult::Ok;
+}
+
+bool EventLoop::update(int fd, Watch &watch)
+{
+    uint32_t events = (watch.reader ? EPOLLIN : 0) | (watch.writer ? EPOLLOUT : 0);
+
+    if(events == 0)
+    {
+        if(watch.registered)
+            epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+
+        m_watches.erase(fd);
+
+        return true;
+    }
+
+    epoll_event event{};
+
+    event.events  = events;
+    event.data.fd = fd;
+
+    if(epoll_ctl(m_epoll, watch.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) == -1)
+        return false;
+
+    watch.registered = true;
+
+    return true;
+}
+
+void EventLoop::poll(int timeout)
+{
+    if(m_waiting == 0)
+        return;
+
+    std::array<epoll_event, 64> events;
+
+    int count = epoll_wait(m_epoll, events.data(), events.size(), timeout);
+
+    for(int i = 0; i < count; i++)
+    {
+        int fd = events[i].data.fd;
+
+        auto it = m_watches.find(fd);
+
+        if(it == m_watches.end())
+            continue;
+
+        Watch &watch = it->second;
+
+        // errors and hang ups wake both sides, the retried operation is what reports them
+        uint32_t flags  = events[i].events;
+        bool     failed = flags & (EPOLLERR | EPOLLHUP);
+
+        if(watch.reader && (flags & EPOLLIN || failed))
+            retry(watch.reader);
+
+        if(watch.writer && (flags & EPOLLOUT || failed))
+            retry(watch.writer);
+
+        update(fd, watch);
+    }
+}
+
+void EventLoop::retry(std::optional<Waiter> &waiter)
+{
+    auto result = waiter->attempt();
+
+    if(!result.has_value())
+        return;
+
+    m_ready.push_back({std::move(waiter->fiber), std::move(result.value())});
+    m_waiting--;
+
+    waiter.reset();
+}
+
+std::optional<Value> events::read(int fd)
+{
+    thread_local std::array<char, ReadSize> buffer;
+
+    while(true)
+    {
+        ssize_t count = ::read(fd, buffer.data(), buffer.size());
+
+        if(count >= 0)
+            return Value(new String(std::string_view{buffer.data(), (size_t)count}));
+
+        if(would_block())
+            return std::nullopt;
+
+        if(errno != EINTR)
+            return Value(nullptr);
+    }
+}
+
+EventLoop::Attempt events::write(int fd, std::string &&data)
+{
+    return [fd, data = std::move(data), written = size_t{0}]() mutable -> std::optional<Value>
+    {
+        while(written < data.size())
+        {
+            ssize_t count = write_quietly(fd, data.data() + written, data.size() - written);
+
+            if(count > 0)
+                written += count;
+            else if(would_block())
+                return std::nullopt;
+            else if(errno != EINTR)
+                return Value(nullptr);
+        }
+
+        return Value((int64_t)written);
+    };
+}
+
+std::optional<Value> events::accept(int fd)
+{
+    while(true)
+    {
+        int client = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if(client != -1)
+            return Value((int64_t)client);
+
+        if(would_block())
+            return std::nullopt;
+
+        if(errno != EINTR && errno != ECONNABORTED)
+            return Value(nullptr);
+    }
+}
+
+int events::connect(const std::string &host, int64_t port)
+{
+    sockaddr_storage address;
+    socklen_t length;
+
+    if(!resolve(host, port, address, length))
+        return -1;
+
+    int fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if(fd == -1)
+        return -1;
+
+    if(::connect(fd, (sockaddr*)&address, length) == -1 && errno != EINPROGRESS)
+    {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+std::optional<Value> events::connected(int fd)
+{
+    if(!ready(fd, POLLOUT))
+        return std::nullopt;
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+
+    if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error != 0)
+    {
+        ::close(fd);
+        return Value(nullptr);
+    }
+
+    return Value((int64_t)fd);
+}
+
+std::optional<Value> events::input()
+{
+    // a line that is already buffered or a stdin that is not a terminal or pipe never has to wait
+    if(std::cin.rdbuf()->in_avail() <= 0 && !ready(STDIN_FILENO, POLLIN))
+        return std::nullopt;
+
+    std::string line;
+
+    std::getline(std::cin, line);
+
+    return Value(new String(std::move(line)));
+}
+
+Value events::pipe()
+{
+    int fds[2];
+
+    if(pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1)
+        return Value(nullptr);
+
+    auto tuple = new Tuple(2);
+
+    tuple->data.emplace_back((int64_t)fds[0]);
+    tuple->data.emplace_back((int64_t)fds[1]);
+
+    return tuple;
+}
+
+Value events::open(const std::string &path, std::string_view mode)
+{
+    int flags;
+
+    if(mode == "r")
+        flags = O_RDONLY;
+    else if(mode == "w")
+        flags = O_WRONLY | O_CREAT | O_TRUNC;
+    else if(mode == "a")
+        flags = O_WRONLY | O_CREAT | O_APPEND;
+    else
+        return Value(nullptr);
+
+    int fd = ::open(path.c_str(), flags | O_NONBLOCK | O_CLOEXEC, 0644);
+
+    return fd == -1 ? Value(nullptr) : Value((int64_t)fd);
+}
+
+Value events::listen(const std::string &host, int64_t port)
+{
+    sockaddr_storage address;
+    socklen_t length;
+
+    if(!resolve(host, port, address, length))
+        return Value(nullptr);
+
+    int fd = socket(address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if(fd == -1)
+        return Value(nullptr);
+
+    int reuse = 1;
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if(bind(fd, (sockaddr*)&address, length) == -1 || ::listen(fd, SOMAXCONN) == -1)
+    {
+        ::close(fd);
+        return Value(nullptr);
+    }
+
+    return Value((int64_t)fd);
+}
+
+Value events::port(int fd)
+{
+    sockaddr_storage address;
+    socklen_t length = sizeof(address);
+
+    if(getsockname(fd, (sockaddr*)&address, &length) == -1)
+        return Value(nullptr);
+
+    if(address.ss_family == AF_INET)
+        return Value((int64_t)ntohs(((sockaddr_in*)&address)->sin_port));
+    if(address.ss_family == AF_INET6)
+        return Value((int64_t)ntohs(((sockaddr_in6*)&address)->sin6_port));
+
+    return Value(nullptr);
+}
+
+void events::close(int fd)
+{
+    ::close(fd);
+}
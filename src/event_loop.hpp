@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+
+#include "value.hpp"
+
+class VM;
+struct Fiber;
+enum class InterpretResult;
+
+/*
+ * runs async calls of one vm on top of epoll. an async call is a coroutine the loop resumes, when it reaches
+ * io that would block the builtin parks it on the descriptor and suspends it so the loop can resume another
+ * call, once epoll reports the descriptor ready the operation is retried and the call resumed with its result.
+ * descriptors made by the io builtins are non blocking, outside of async calls the builtins simply wait
+ */
+class EventLoop
+{
+public:
+    // performs the operation, nullopt if it would block. it keeps its own progress, like how much was written
+    using Attempt = std::function<std::optional<Value>()>;
+
+    enum class Direction : uint8_t
+    {
+        Read,
+        Write,
+    };
+
+    EventLoop();
+
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // queues an async call, the next run of the loop starts it with argument
+    void queue(std::shared_ptr<Fiber> &&fiber, Value &&argument);
+
+    // pushes what attempt gives back. an async call that would block is suspended until fd is ready,
+    // anything else blocks the thread until it is
+    void perform(VM &vm, int fd, Direction direction, Attempt &&attempt);
+
+    // resumes the calls waiting on fd with nil, for descriptors that are about to be closed
+    void forget(int fd);
+
+    // runs queued calls until every one of them has finished, vm must not be running one of them
+    InterpretResult run(VM &vm);
+
+private:
+    struct Waiter
+    {
+        std::shared_ptr<Fiber> fiber;
+        Attempt attempt;
+    };
+
+    struct Watch
+    {
+        std::optional<Waiter> reader;
+        std::optional<Waiter> writer;
+        bool registered = false;
+    };
+
+    struct Ready
+    {
+        std::shared_ptr<Fiber> fiber;
+        Value value;
+    };
+
+    // updates what epoll reports for fd to what is still waited on and forgets fd once nothing is,
+    // false if epoll refused the descriptor
+    bool update(int fd, Watch &watch);
+
+    // waits up to timeout ms for descriptors and retries the operations that became ready
+    void poll(int timeout);
+
+    // moves the call to the ready queue if its operation goes through now
+    void retry(std::optional<Waiter> &waiter);
+
+    int m_epoll;
+
+    std::deque<Ready> m_ready;
+    std::unordered_map<int, Watch> m_watches;
+    size_t m_waiting = 0;
+
+    // set when the call that is running parks itself on a descriptor, a call that suspends without it yielded
+    bool m_parked = false;
+};
+
+// the io the builtins do, each returns nullopt when it would block and nil when it failed
+namespace events
+{
+    // up to 64kb of what is available, an empty string at the end of the stream
+    std::optional<Value> read(int fd);
+
+    // writes all of data, the attempt remembers how much is done across retries
+    EventLoop::Attempt write(int fd, std::string &&data);
+
+    std::optional<Value> accept(int fd);
+
+    // a socket connecting to host in the background, -1 if it could not even start
+    int connect(const std::string &host, int64_t port);
+
+    // the socket once it is connected, nil if connecting failed
+    std::optional<Value> connected(int fd);
+
+    // the next line of stdin without the newline
+    std::optional<Value> input();
+
+    // a non blocking pipe as a tuple of the read and the write end
+    Value pipe();
+
+    // mode is "r", "w" or "a" like fopen
+    Value open(const std::string &path, std::string_view mode);
+
+    Value listen(const std::string &host, int64_t port);
+
+    // the port a socket is bound to, so a listener on port 0 can tell which one it got
+    Value port(int fd);
+
+    void close(int fd);
+}
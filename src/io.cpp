@@ -1,9 +1,15 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 
 #include "io.hpp"
 
 #if defined(WIN32)
 #include <windows.h>
 #elif defined(__linux__)
+#include <atomic>
+#include <cerrno>
+#include <poll.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 #else
@@ -19,8 +25,111 @@ void mio::print(std::string_view message)
 #if defined(WIN32)
     WriteConsole(STDOUT_H, message.data(), message.size(), 0, nullptr);
 #elif defined(__linux__)
-    write(STDOUT_FILENO, message.data(), message.size());
+    // write can take less than the whole message when stdout is a pipe
+    while(!message.empty())
+    {
+        ssize_t written = write(STDOUT_FILENO, message.data(), message.size());
+
+        if(written == -1 && errno == EINTR)
+            continue;
+
+        // stdout is shared with whoever started the program and may have been made non-blocking,
+        // the rest is written once it can take more
+        if(written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            pollfd out = {.fd = STDOUT_FILENO, .events = POLLOUT};
+
+            poll(&out, 1, -1);
+            continue;
+        }
+
+        if(written <= 0)
+        {
+            // said once, a closed pipe would otherwise be reported on every flush
+            static std::atomic<bool> reported = false;
+
+            if(!reported.exchange(true))
+                std::fprintf(stderr, "could not write to stdout: %s\n", written == 0 ? "nothing was written" : std::strerror(errno));
+
+            return;
+        }
+
+        message.remove_prefix(written);
+    }
 #else
     std::cout << message;
 #endif
 }
+
+bool mio::stdout_is_tty()
+{
+#if defined(WIN32)
+    return GetFileType(STDOUT_H) == FILE_TYPE_CHAR;
+#elif defined(__linux__)
+    return isatty(STDOUT_FILENO);
+#else
+    return true;
+#endif
+}
+
+mio::OutputBuffer::OutputBuffer(size_t capacity) :
+    OutputBuffer(capacity, stdout_is_tty() ? FlushPolicy::Line : FlushPolicy::Block)
+{}
+
+mio::OutputBuffer::OutputBuffer(size_t capacity, FlushPolicy policy) :
+    m_data(std::make_unique<char[]>(std::max<size_t>(capacity, 1))),
+    m_capacity(std::max<size_t>(capacity, 1)),
+    m_policy(policy)
+{}
+
+mio::OutputBuffer::~OutputBuffer()
+{
+    flush();
+}
+
+void mio::OutputBuffer::write(std::string_view data)
+{
+    if(m_size + data.size() > m_capacity)
+    {
+        flush();
+
+        // too big to ever fit so it skips the copy
+        if(data.size() >= m_capacity)
+            return print(data);
+    }
+
+    std::memcpy(m_data.get() + m_size, data.data(), data.size());
+    m_size += data.size();
+
+    if(m_policy == FlushPolicy::Line && data.find('\n') != std::string_view::npos)
+        flush();
+}
+
+void mio::OutputBuffer::put(char c)
+{
+    if(m_size == m_capacity)
+        flush();
+
+    m_data[m_size++] = c;
+
+    if(m_policy == FlushPolicy::Line && c == '\n')
+        flush();
+}
+
+void mio::OutputBuffer::flush()
+{
+    if(m_size == 0)
+        return;
+
+    print({m_data.get(), m_size});
+
+    m_size = 0;
+}
+
+void mio::OutputBuffer::resize(size_t capacity)
+{
+    flush();
+
+    m_capacity = std::max<size_t>(capacity, 1);
+    m_data     = std::make_unique<char[]>(m_capacity);
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <cstddef>
+#include <memory>
 #include <string_view>
 
 /*
@@ -11,4 +14,59 @@
 namespace mio
 {
     void print(std::string_view message);
+
+    // true if stdout is a terminal
+    bool stdout_is_tty();
+
+    enum class FlushPolicy : uint8_t
+    {
+        // flushes after every write that contains a newline, used for terminals so output shows up as it is printed
+        Line,
+        // flushes only when the buffer is full or flush is called, used for pipes and files
+        Block,
+    };
+
+    constexpr size_t DefaultBufferSize = 1 << 14;
+
+    /*
+     * buffers stdout so printing many small values costs one write per buffer instead of one per value
+     * the buffer is flushed when it is destroyed
+     */
+    class OutputBuffer
+    {
+    public:
+        explicit OutputBuffer(size_t capacity = DefaultBufferSize);
+
+        OutputBuffer(size_t capacity, FlushPolicy policy);
+
+        OutputBuffer(const OutputBuffer&) = delete;
+        OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+        ~OutputBuffer();
+
+        void write(std::string_view data);
+
+        void put(char c);
+
+        void flush();
+
+        // flushes what is already buffered before changing the size
+        void resize(size_t capacity);
+
+        void set_policy(FlushPolicy policy)
+        {
+            m_policy = policy;
+        }
+
+        FlushPolicy policy() const
+        {
+            return m_policy;
+        }
+
+    private:
+        std::unique_ptr<char[]> m_data;
+        size_t m_capacity;
+        size_t m_size = 0;
+        FlushPolicy m_policy;
+    };
 }
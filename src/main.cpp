@@ -1,16 +1,21 @@
 #include <iostream>
 #include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "vm.hpp"
 #include "types/chunk.hpp"
 #include "compiler.hpp"
+#include "cache.hpp"
+#include "module.hpp"
 #include "util/util.hpp"
 #include "util/fmt.hpp"
 #include "util/debug.hpp"
 
 /*
  * TODO:
- * add bitwise operators
  * string escaping
  */
 
@@ -80,22 +85,133 @@ void repl()
     }
 }
 
-void run_file(const char *path)
+void run_file(const char *path, bool lazy, bool snapshot, bool parallel)
 {
     auto contents = read_file(path);
 
     if(!contents.has_value())
         fmt::fatal("could not read input file");
 
+    // asking for a way to compile means compiling, an image or cache from an earlier run would skip it
+    bool cached = !lazy && !parallel;
+
+    if(auto image = cached ? cache::load_image(path, contents.value()) : std::nullopt; image.has_value())
+    {
+        VM vm;
+
+        InterpretResult result = vm.interpret(std::move(image->entry), std::move(image->globals));
+
+        return;
+    }
+
+    auto program = cached ? cache::load(path, contents.value()) : std::nullopt;
+
+    if(!program.has_value())
+    {
+        // a parallel compile skips the bodies like a lazy one and then compiles all of them at once
+        Compiler compiler(contents.value(), lazy || parallel);
+
+        program = compiler.compile();
+
+        if(!program.has_value())
+            return;
+
+        if(parallel && !lazy && !Compiler::compile_parallel(program.value(), std::thread::hardware_concurrency()))
+            return;
+
+        // lazy programs still need their source to finish compiling so there is nothing complete to cache
+        if(!lazy)
+            cache::store(path, contents.value(), program.value());
+    }
+
+    VM vm;
+
+    // lazy bodies are not compiled until called so they cannot be written to an image either
+    if(snapshot && !lazy)
+    {
+        cache::Image image;
+
+        image.entry = Compiler::split_entry(program.value());
+
+        if(vm.interpret(std::move(program.value())) != InterpretResult::Ok)
+            return;
+
+        image.globals = vm.globals();
+
+        if(!cache::store_image(path, contents.value(), image))
+            fmt::eprint("could not write an image of {}\n", path);
+
+        InterpretResult result = vm.interpret(std::move(image.entry));
+
+        return;
+    }
+
+    InterpretResult result = vm.interpret(std::move(program.value()));
+}
+
+// compiles while the source is still being read, there is no complete source to cache or to compile lazily from
+void run_stream(int fd)
+{
+    std::optional<Function> program;
+
+    {
+        Compiler compiler(fd);
+
+        program = compiler.compile();
+    }
+
+    if(!program.has_value())
+        return;
+
     VM vm;
 
-    InterpretResult result = vm.interpret(contents.value());
+    InterpretResult result = vm.interpret(std::move(program.value()));
 }
 
 int main(int argc, char **argv)
 {
-    if(argc >= 2)
-        run_file(argv[1]);
+    bool lazy     = false;
+    bool snapshot = false;
+    bool stream   = false;
+    bool parallel = false;
+
+    for(int i = 1; i < argc-1; i++)
+    {
+        std::string_view flag = argv[i];
+
+        if(flag == "--lazy")
+            lazy = true;
+        else if(flag == "--snapshot")
+            snapshot = true;
+        else if(flag == "--stream")
+            stream = true;
+        else if(flag == "--parallel")
+            parallel = true;
+        else
+            fmt::fatal("unknown flag {}", flag);
+    }
+
+    // imports are looked for next to the main script first, or in the working directory for stdin and the repl
+    std::filesystem::path directory = argc >= 2 ? std::filesystem::path(argv[argc-1]).parent_path() : "";
+
+    module::add_search_path(directory.empty() ? "." : directory);
+
+    // - reads the program from stdin
+    if(argc >= 2 && std::string_view(argv[argc-1]) == "-")
+        run_stream(STDIN_FILENO);
+    else if(argc >= 2 && stream)
+    {
+        int fd = open(argv[argc-1], O_RDONLY);
+
+        if(fd < 0)
+            fmt::fatal("could not read input file");
+
+        run_stream(fd);
+
+        close(fd);
+    }
+    else if(argc >= 2)
+        run_file(argv[argc-1], lazy, snapshot, parallel);
     else
         repl();
 
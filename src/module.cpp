@@ -0,0 +1,112 @@
+#include <mutex>
+#include <vector>
+#include <cstdlib>
+#include <unordered_map>
+
+#include "module.hpp"
+#include "compiler.hpp"
+#include "cache.hpp"
+#include "util/util.hpp"
+
+namespace
+{
+    struct Module
+    {
+        // names and string constants in the program point into the source so it is kept alongside it
+        SourceFile source;
+        std::optional<Function> program;
+    };
+
+    std::mutex g_mutex;
+
+    std::vector<std::filesystem::path> g_search_paths;
+
+    std::unordered_map<std::string, Module> g_modules;
+
+    std::vector<std::filesystem::path> search_paths()
+    {
+        std::vector<std::filesystem::path> paths = g_search_paths;
+
+        if(const char *env = std::getenv("STRIX_PATH"))
+        {
+            std::string_view list = env;
+
+            while(!list.empty())
+            {
+                size_t end = std::min(list.find(':'), list.size());
+
+                if(end != 0)
+                    paths.emplace_back(list.substr(0, end));
+
+                list.remove_prefix(std::min(end + 1, list.size()));
+            }
+        }
+
+        return paths;
+    }
+
+    std::optional<std::filesystem::path> resolve(std::string_view name)
+    {
+        std::filesystem::path file_name = std::string(name) + ".strix";
+
+        for(auto &directory : search_paths())
+        {
+            std::error_code error;
+
+            std::filesystem::path path = directory / file_name;
+
+            if(std::filesystem::is_regular_file(path, error))
+                return path;
+        }
+
+        return std::nullopt;
+    }
+}
+
+void module::add_search_path(std::filesystem::path directory)
+{
+    std::lock_guard lock(g_mutex);
+
+    g_search_paths.push_back(std::move(directory));
+}
+
+const Function* module::load(std::string_view name)
+{
+    std::lock_guard lock(g_mutex);
+
+    // failed modules are remembered too so they are not compiled again for every import
+    if(auto it = g_modules.find(std::string(name)); it != g_modules.end())
+        return it->second.program ? &it->second.program.value() : nullptr;
+
+    Module &entry = g_modules[std::string(name)];
+
+    auto path = resolve(name);
+
+    if(!path.has_value())
+        return nullptr;
+
+    auto source = read_file(std::filesystem::path(path.value()));
+
+    if(!source.has_value())
+        return nullptr;
+
+    entry.source = std::move(source.value());
+
+    std::string_view contents = entry.source.view();
+
+    entry.program = cache::load(path.value(), contents, cache::Kind::Module);
+
+    if(!entry.program.has_value())
+    {
+        Compiler compiler(contents);
+
+        entry.program = compiler.compile_module();
+
+        if(!entry.program.has_value())
+            return nullptr;
+
+        cache::store(path.value(), contents, entry.program.value(), cache::Kind::Module);
+    }
+
+    return &entry.program.value();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+
+#include "objects/function.hpp"
+
+/*
+ * import name looks for name.strix in the directory of the main script and then in every directory listed
+ * in STRIX_PATH. a module is compiled at most once per process and its program is cached on disk next to
+ * its source like any other program, every vm that imports it runs its own copy against its own globals.
+ * the import is a map from the names of its top level declarations to those globals, so reading a member
+ * always gives its current value
+ */
+namespace module
+{
+    // directories added here are searched before the ones in STRIX_PATH, in the order they were added
+    void add_search_path(std::filesystem::path directory);
+
+    // the compiled program of the module, nullptr if it cannot be found or does not compile
+    const Function* load(std::string_view name);
+}
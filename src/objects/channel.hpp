@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <thread>
+
+#include "../types/object.hpp"
+#include "../value.hpp"
+
+/*
+ * a bounded multi producer multi consumer queue over a ring of cells (dmitry vyukovs design). every cell
+ * carries a sequence number telling whether it is ready to be written or read for the current lap, so senders
+ * and receivers only contend on their own end and never take a lock. a full or empty ring makes the blocking
+ * calls sleep on the sequence of the cell they are after until the other side moves it
+ */
+struct Ring
+{
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Value value;
+    };
+
+    // the cell a full or empty ring stopped at and the sequence it had then
+    struct Blocked
+    {
+        Cell *cell{};
+        size_t sequence{};
+    };
+
+    explicit Ring(size_t capacity) :
+        m_mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        m_cells(std::make_unique<Cell[]>(m_mask + 1))
+    {
+        for(size_t i = 0; i <= m_mask; i++)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    // value is moved in and left alone if the ring is full
+    bool try_send(Value &value)
+    {
+        return try_send(value, nullptr);
+    }
+
+    bool try_recv(Value &value)
+    {
+        return try_recv(value, nullptr);
+    }
+
+    void send(Value &&value)
+    {
+        Blocked blocked;
+
+        while(!try_send(value, &blocked))
+            wait(blocked);
+    }
+
+    Value recv()
+    {
+        Value value;
+        Blocked blocked;
+
+        while(!try_recv(value, &blocked))
+            wait(blocked);
+
+        return value;
+    }
+
+private:
+
+    // sequence numbers count laps around the ring so they are compared as signed distances
+    static intptr_t distance(size_t sequence, size_t position)
+    {
+        return (intptr_t)sequence - (intptr_t)position;
+    }
+
+    // blocked is set to the cell the caller has to wait on when the ring is full
+    bool try_send(Value &value, Blocked *blocked)
+    {
+        size_t position = m_head.load(std::memory_order_relaxed);
+
+        while(true)
+        {
+            Cell &cell = m_cells[position & m_mask];
+
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+
+            intptr_t dif = distance(sequence, position);
+
+            if(dif == 0)
+            {
+                if(m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::move(value);
+
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    cell.sequence.notify_all();
+
+                    return true;
+                }
+            }
+            else if(dif < 0)
+            {
+                if(blocked)
+                    *blocked = {&cell, sequence};
+
+                return false;
+            }
+            else
+                position = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool try_recv(Value &value, Blocked *blocked)
+    {
+        size_t position = m_tail.load(std::memory_order_relaxed);
+
+        while(true)
+        {
+            Cell &cell = m_cells[position & m_mask];
+
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+
+            intptr_t dif = distance(sequence, position + 1);
+
+            if(dif == 0)
+            {
+                if(m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.value);
+
+                    cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+                    cell.sequence.notify_all();
+
+                    return true;
+                }
+            }
+            else if(dif < 0)
+            {
+                if(blocked)
+                    *blocked = {&cell, sequence};
+
+                return false;
+            }
+            else
+                position = m_tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    // spins briefly since the other side is usually about to move, then sleeps until the cell changes
+    static void wait(const Blocked &blocked)
+    {
+        auto &sequence = blocked.cell->sequence;
+
+        for(int i = 0; i < 64; i++)
+        {
+            if(sequence.load(std::memory_order_acquire) != blocked.sequence)
+                return;
+
+            std::this_thread::yield();
+        }
+
+        sequence.wait(blocked.sequence, std::memory_order_acquire);
+    }
+
+    size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+
+    // the ends live on cache lines of their own so senders and receivers do not slow each other down
+    alignas(64) std::atomic<size_t> m_head = 0;
+    alignas(64) std::atomic<size_t> m_tail = 0;
+};
+
+// copies of a channel are the same channel, that is how one is handed to a task
+struct Channel : Object
+{
+    std::shared_ptr<Ring> ring;
+
+    explicit Channel(size_t capacity) :
+        ring(std::make_shared<Ring>(capacity))
+    {}
+
+    Channel(const Channel &channel) = default;
+
+    Channel(Channel &&channel) = default;
+
+    Object* clone() override
+    {
+        return new Channel(*this);
+    }
+
+    Object* move() override
+    {
+        return new Channel(std::move(*this));
+    }
+
+    ObjectType type() const override
+    {
+        return ObjectType::Channel;
+    }
+
+    std::string to_string() const override
+    {
+        return "channel";
+    }
+
+    bool compare(const Object *obj) override
+    {
+        return obj->type() == ObjectType::Channel && static_cast<const Channel*>(obj)->ring == ring;
+    }
+};
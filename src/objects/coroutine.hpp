@@ -0,0 +1,104 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "../types/object.hpp"
+#include "../vm.hpp"
+#include "function.hpp"
+#include "../util/fmt.hpp"
+
+// the local slots every coroutine gets for its own frames and the calls it makes
+constexpr size_t FiberSlots = 512;
+
+/*
+ * the state of a coroutine. it runs on call frames, an operand stack and local slots of its own, resuming
+ * it swaps its stack, slots and open upvalues with the vms and moves its frames on top of the resumers,
+ * yielding swaps them back. see VM::resume and VM::suspend
+ */
+struct Fiber
+{
+    enum class Status : uint8_t
+    {
+        Suspended,
+        Running,
+        Done,
+    };
+
+    Function function;
+    Status status = Status::Suspended;
+    bool started = false;
+    // run by the event loop, io that would block suspends it instead of the whole vm
+    bool async = false;
+
+    // the coroutines frames while it is suspended
+    std::vector<CallFrame> frames;
+
+    // these hold the coroutines own stack, upvalues and slot range while it is suspended
+    // and the resumers while it runs, a switch swaps them with the vms
+    std::vector<Value> stack;
+    std::vector<std::shared_ptr<Upvalue>> open_upvalues;
+    Value *data_top{};
+    Value *data_end{};
+
+    std::unique_ptr<Value[]> slots;
+
+    // set while it runs
+    std::shared_ptr<Fiber> resumer;
+    uint8_t base_frame{};
+    // the slots of the for loop that resumed it, what it yields is bound to the loop variable instead of pushed
+    Value *loop_base{};
+
+    Fiber(Function &&function) :
+        function(std::move(function))
+    {}
+
+    // closures made inside the coroutine can outlive it so their variables are moved out of its slots
+    ~Fiber()
+    {
+        for(auto &upvalue : open_upvalues)
+        {
+            upvalue->closed   = std::move(*upvalue->location);
+            upvalue->location = &upvalue->closed;
+        }
+    }
+};
+
+struct Coroutine : Object
+{
+    // copies of a coroutine share its state so resuming any of them continues the same coroutine
+    std::shared_ptr<Fiber> fiber;
+
+    Coroutine(Function &&function) :
+        fiber(std::make_shared<Fiber>(std::move(function)))
+    {}
+
+    Coroutine(const Coroutine &coroutine) = default;
+
+    Coroutine(Coroutine &&coroutine) = default;
+
+    Object* clone() override
+    {
+        return new Coroutine(*this);
+    }
+
+    Object* move() override
+    {
+        return new Coroutine(std::move(*this));
+    }
+
+    ObjectType type() const override
+    {
+        return ObjectType::Coroutine;
+    }
+
+    std::string to_string() const override
+    {
+        return fmt::format("coroutine {}", fiber->function.name);
+    }
+
+    bool compare(const Object *obj) override
+    {
+        return obj->type() == ObjectType::Coroutine && static_cast<const Coroutine*>(obj)->fiber == fiber;
+    }
+};
@@ -1,14 +1,57 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "../types/object.hpp"
 #include "../types/chunk.hpp"
 
+// a variable captured by a closure. location points at the variables slot while its frame is alive
+// and at closed once the slot goes out of scope so every closure sharing it sees the same value
+struct Upvalue
+{
+    Value *location;
+    Value closed;
+
+    Upvalue(Value *location) :
+        location(location)
+    {}
+};
+
+// defined by the compiler, see compiler.hpp
+struct LazyBody;
+
+// where a closure gets an upvalue from when it is created
+struct Capture
+{
+    // true if the variable is a slot in the enclosing frame, false if it is one of the enclosing functions upvalues
+    bool is_local;
+    uint16_t index;
+
+    // a local capture with this index is the function whose frame creates the closure. closures inside a
+    // function reach it by its name this way, capturing the slot it is stored in would make it own itself
+    static constexpr uint16_t Callee = UINT16_MAX;
+};
+
 struct Function : Object
 {
-    Chunk chunk;
+    // immutable once compiled, so copies of a function (and vms on other threads) share one chunk
+    std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
     std::string_view name;
     std::string_view fn_string;
     uint8_t param_count{};
+    // the number of local slots a call reserves in the vms memory
+    uint16_t slot_count{};
+
+    // empty unless the function refers to locals of an enclosing function
+    std::vector<Capture> captures;
+    std::vector<std::shared_ptr<Upvalue>> upvalues;
+
+    // set while the body has not been compiled yet, the chunk is empty until then
+    std::shared_ptr<LazyBody> lazy;
+
+    // the globals of the module the function was declared in, nullptr for the main program
+    Value *globals = nullptr;
 
     Function() = default;
 
@@ -17,13 +60,19 @@ struct Function : Object
     {}
 
     Function(const Function &fn) :
-        chunk(fn.chunk)
+        chunk(fn.chunk),
+        captures(fn.captures),
+        upvalues(fn.upvalues),
+        lazy(fn.lazy)
     {
         set_fields(fn);
     }
 
     Function(Function &&fn):
-        chunk(std::move(fn.chunk))
+        chunk(std::move(fn.chunk)),
+        captures(std::move(fn.captures)),
+        upvalues(std::move(fn.upvalues)),
+        lazy(std::move(fn.lazy))
     {
         set_fields(fn);
     }
@@ -31,7 +80,10 @@ struct Function : Object
     Function& operator=(Function &&fn) noexcept
     {
         set_fields(fn);
-        chunk = std::move(fn.chunk);
+        chunk    = std::move(fn.chunk);
+        captures = std::move(fn.captures);
+        upvalues = std::move(fn.upvalues);
+        lazy     = std::move(fn.lazy);
         return *this;
     }
 
@@ -63,6 +115,8 @@ private:
         name        = fn.name;
         fn_string   = fn.fn_string;
         param_count = fn.param_count;
+        slot_count  = fn.slot_count;
+        globals     = fn.globals;
     }
 };
 
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+
+#include "../types/object.hpp"
+#include "../value.hpp"
+#include "map.hpp"
+
+/*
+ * dispatch table for switch statements whose case labels are all constants
+ * targets are absolute instruction indexes into the chunk that owns the table.
+ * dense tables index straight into targets with the scrutinee, sparse ones hash it.
+ */
+struct JumpTable : Object
+{
+    JumpTable(size_t default_target) :
+        default_target(default_target)
+    {}
+
+    JumpTable(const JumpTable &table) = default;
+
+    JumpTable(JumpTable &&table) = default;
+
+    Object* clone() override
+    {
+        return new JumpTable(*this);
+    }
+
+    Object* move() override
+    {
+        return new JumpTable(std::move(*this));
+    }
+
+    std::string to_string() const override
+    {
+        return targets.empty() ? cases.to_string() : fmt_dense();
+    }
+
+    ObjectType type() const override
+    {
+        return ObjectType::JumpTable;
+    }
+
+    // used by TableSwitch, case labels are the integers low..low+targets.size()
+    size_t dense_target(const Value &value) const
+    {
+        int64_t key;
+
+        if(value.type == ValueType::Int)
+            key = value.as.integer;
+        else if(value.type == ValueType::Number && value.as.number >= -0x1p63 && value.as.number < 0x1p63
+                && std::floor(value.as.number) == value.as.number)
+            key = value.as.number;
+        else
+            return default_target;
+
+        // wraps around for keys below low so a single comparison covers both bounds
+        uint64_t index = (uint64_t)key - (uint64_t)low;
+
+        return index < targets.size() ? targets[index] : default_target;
+    }
+
+    // used by LookupSwitch
+    size_t lookup_target(const Value &value)
+    {
+        if(!Map::hashable(value))
+            return default_target;
+
+        Value *target = cases.find(value);
+
+        return target ? (size_t)target->as.integer : default_target;
+    }
+
+    int64_t low{};
+    std::vector<size_t> targets;
+
+    Map cases;
+
+    size_t default_target;
+
+private:
+    std::string fmt_dense() const
+    {
+        std::string result = "[ ";
+
+        for(size_t i = 0; i < targets.size(); i++)
+            result += std::to_string(low + (int64_t)i) + ": " + std::to_string(targets[i]) + (i+1 < targets.size() ? ", " : " ");
+
+        return result + "]";
+    }
+};
@@ -0,0 +1,237 @@
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "map.hpp"
+#include "string.hpp"
+
+// keeps the table at most 7/8 full, robin hood probing stays short well past the usual 0.75
+constexpr size_t MaxLoadNumerator   = 7;
+constexpr size_t MaxLoadDenominator = 8;
+constexpr size_t MinCapacity        = 8;
+
+std::string Map::to_string() const
+{
+    if(length == 0)
+        return "{}";
+
+    std::string result = "{ ";
+    bool first = true;
+
+    for(auto &bucket : buckets)
+    {
+        if(bucket.distance == 0)
+            continue;
+
+        if(!first)
+            result += ", ";
+
+        result += bucket.key.to_string() + ": " + bucket.value.to_string();
+        first = false;
+    }
+
+    result += " }";
+
+    return result;
+}
+
+Value* Map::find(const Value &key)
+{
+    if(length == 0)
+        return nullptr;
+
+    size_t index = find_index(key, hash_of(key));
+
+    return index == buckets.size() ? nullptr : &buckets[index].value;
+}
+
+void Map::set(Value &&key, Value &&value)
+{
+    size_t hash = hash_of(key);
+
+    if(length > 0)
+    {
+        size_t index = find_index(key, hash);
+
+        if(index != buckets.size())
+        {
+            buckets[index].value = std::move(value);
+            return;
+        }
+    }
+
+    if((length + 1) * MaxLoadDenominator > buckets.size() * MaxLoadNumerator)
+        grow();
+
+    insert_bucket(Bucket{std::move(key), std::move(value), hash, 1});
+
+    length++;
+}
+
+bool Map::erase(const Value &key)
+{
+    if(length == 0)
+        return false;
+
+    size_t index = find_index(key, hash_of(key));
+
+    if(index == buckets.size())
+        return false;
+
+    size_t mask = buckets.size() - 1;
+
+    // backward shift deletion, pulls the following displaced entries one slot closer to home
+    // so no tombstones are needed
+    for(size_t next = (index + 1) & mask; buckets[next].distance > 1; next = (next + 1) & mask)
+    {
+        buckets[index] = std::move(buckets[next]);
+        buckets[index].distance--;
+        index = next;
+    }
+
+    buckets[index] = Bucket{};
+
+    length--;
+
+    return true;
+}
+
+size_t Map::next(size_t cursor) const
+{
+    while(cursor < buckets.size() && buckets[cursor].distance == 0)
+        cursor++;
+
+    return cursor;
+}
+
+void Map::reserve(size_t count)
+{
+    size_t capacity = std::bit_ceil(std::max(MinCapacity, count * MaxLoadDenominator / MaxLoadNumerator + 1));
+
+    if(capacity <= buckets.size())
+        return;
+
+    std::vector<Bucket> old = std::move(buckets);
+
+    buckets = std::vector<Bucket>(capacity);
+
+    for(auto &bucket : old)
+    {
+        if(bucket.distance == 0)
+            continue;
+
+        bucket.distance = 1;
+        insert_bucket(std::move(bucket));
+    }
+}
+
+bool Map::hashable(const Value &key)
+{
+    switch(key.type)
+    {
+        case ValueType::Number:
+        case ValueType::Int:
+        case ValueType::Bool:   return true;
+        case ValueType::Object: return key.as.object->is(ObjectType::String);
+        default:                return false;
+    }
+}
+
+size_t Map::hash_of(const Value &key)
+{
+    switch(key.type)
+    {
+        case ValueType::Int:
+            // fibonacci hashing spreads the low entropy bits of small integers
+            return (uint64_t)key.as.integer * 0x9E3779B97F4A7C15ull >> 16;
+        case ValueType::Number:
+        {
+            double number = key.as.number;
+
+            // integral doubles compare equal to the matching int so they must land in the same bucket,
+            // this also folds -0 into 0
+            if(number >= -0x1p63 && number < 0x1p63 && std::floor(number) == number)
+                return (uint64_t)(int64_t)number * 0x9E3779B97F4A7C15ull >> 16;
+
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof(bits));
+
+            return bits * 0x9E3779B97F4A7C15ull >> 16;
+        }
+        case ValueType::Bool:   return key.as.boolean;
+        case ValueType::Object: return key.get<String>()->hash;
+        default:                return 0;
+    }
+}
+
+size_t Map::find_index(const Value &key, size_t hash) const
+{
+    size_t mask  = buckets.size() - 1;
+    size_t index = hash & mask;
+
+    for(uint32_t distance = 1; buckets[index].distance >= distance; distance++)
+    {
+        const Bucket &bucket = buckets[index];
+
+        if(bucket.hash == hash && keys_equal(bucket.key, key))
+            return index;
+
+        index = (index + 1) & mask;
+    }
+
+    return buckets.size();
+}
+
+void Map::insert_bucket(Bucket &&bucket)
+{
+    size_t mask  = buckets.size() - 1;
+    size_t index = bucket.hash & mask;
+
+    while(true)
+    {
+        Bucket &current = buckets[index];
+
+        if(current.distance == 0)
+        {
+            current = std::move(bucket);
+            return;
+        }
+
+        // the incoming entry is further from home than the resident so it takes the slot
+        if(current.distance < bucket.distance)
+            std::swap(current, bucket);
+
+        index = (index + 1) & mask;
+        bucket.distance++;
+    }
+}
+
+void Map::grow()
+{
+    reserve(buckets.empty() ? MinCapacity : buckets.size());
+}
+
+bool Map::keys_equal(const Value &a, const Value &b)
+{
+    if(a.is_number() && b.is_number())
+    {
+        if(a.type == b.type)
+            return a.type == ValueType::Int ? a.as.integer == b.as.integer : a.as.number == b.as.number;
+
+        // compared as integers so large ints are not rounded into a neighbouring double
+        int64_t integer = a.type == ValueType::Int ? a.as.integer : b.as.integer;
+        double  number  = a.type == ValueType::Int ? b.as.number  : a.as.number;
+
+        return number >= -0x1p63 && number < 0x1p63 && std::floor(number) == number && (int64_t)number == integer;
+    }
+
+    if(a.type != b.type)
+        return false;
+
+    switch(a.type)
+    {
+        case ValueType::Bool:   return a.as.boolean == b.as.boolean;
+        case ValueType::Object: return a.get<String>()->data == b.get<String>()->data;
+        default:                return false;
+    }
+}
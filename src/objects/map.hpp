@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+
+#include "../types/object.hpp"
+#include "../value.hpp"
+
+/*
+ * open addressing hash map using robin hood probing
+ * entries that are further from their home bucket steal the slot of entries that are closer to theirs,
+ * which keeps probe sequences short and lets lookups stop as soon as they pass a richer entry.
+ * string keys use the hash cached on the string object so they are never rehashed.
+ */
+struct Map : Object
+{
+    struct Bucket
+    {
+        Value    key;
+        Value    value;
+        size_t   hash{};
+        // probe distance from the home bucket plus one, zero marks an empty bucket
+        uint32_t distance{};
+    };
+
+    // the length is only a hint used by map literals to size the table up front
+    explicit Map(uint32_t length = 0)
+    {
+        reserve(length);
+    }
+
+    Map(const Map &map) :
+        buckets(map.buckets),
+        length(map.length)
+    {}
+
+    Map(Map &&map) noexcept :
+        buckets(std::move(map.buckets)),
+        length(map.length)
+    {
+        map.length = 0;
+    }
+
+    Object* clone() override
+    {
+        return new Map(*this);
+    }
+
+    Object* move() override
+    {
+        return new Map(std::move(*this));
+    }
+
+    std::string to_string() const override;
+
+    ObjectType type() const override
+    {
+        return ObjectType::Map;
+    }
+
+    // returns nullptr if the key is not present
+    Value* find(const Value &key);
+
+    // inserts or replaces the value for the key
+    void set(Value &&key, Value &&value);
+
+    bool erase(const Value &key);
+
+    // returns the index of the first occupied bucket at or after the cursor, or the bucket count when exhausted
+    size_t next(size_t cursor) const;
+
+    void reserve(size_t count);
+
+    // only numbers, booleans and strings can be used as keys
+    static bool hashable(const Value &key);
+
+    static size_t hash_of(const Value &key);
+
+    std::vector<Bucket> buckets;
+    uint32_t length{};
+
+private:
+    size_t find_index(const Value &key, size_t hash) const;
+
+    void insert_bucket(Bucket &&bucket);
+
+    void grow();
+
+    static bool keys_equal(const Value &a, const Value &b);
+};
@@ -1,9 +1,17 @@
 #pragma once
 
+#include <deque>
+#include <vector>
+#include <unistd.h>
+
 #include "../types/object.hpp"
 #include "../vm.hpp"
 #include "../io.hpp"
 #include "string.hpp"
+#include "coroutine.hpp"
+#include "task.hpp"
+#include "channel.hpp"
+#include "tuple.hpp"
 
 struct NativeFunction : Object
 {
@@ -82,36 +90,453 @@ namespace builtin
         return InterpretResult::RuntimeError;
     }
 
+    // waits for the line through the event loop so an async call reading input does not stop the others
     static InterpretResult input(VM &vm)
     {
         Value message = vm.pop();
 
-        mio::print(message.to_string());
+        vm.m_output.write(message.to_string());
+        vm.m_output.flush();
+
+        vm.events().perform(vm, STDIN_FILENO, EventLoop::Direction::Read, events::input);
 
-        std::string buffer;
+        return vm.m_state;
+    }
 
-        std::getline(std::cin, buffer);
+    // strings are written straight from the object, everything else has to be formatted first
+    static void write_value(VM &vm, const Value &value)
+    {
+        if(auto string = value.get<String>(); string && string->is(ObjectType::String))
+            vm.m_output.write(string->data);
+        else
+            vm.m_output.write(value.to_string());
+    }
 
-        vm.m_stack.emplace_back(new String(std::move(buffer)));
+    static InterpretResult print(VM &vm)
+    {
+        write_value(vm, vm.pop());
 
         return InterpretResult::Ok;
     }
 
-    static InterpretResult print(VM &vm)
+    static InterpretResult println(VM &vm)
     {
-        Value message = vm.pop();
+        write_value(vm, vm.pop());
 
-        mio::print(message.to_string());
+        vm.m_output.put('\n');
 
         return InterpretResult::Ok;
     }
 
-    static InterpretResult println(VM &vm)
+    static InterpretResult flush(VM &vm)
     {
-        Value message = vm.pop();
+        vm.m_output.flush();
+
+        return InterpretResult::Ok;
+    }
+
+    // the function does not start running until the coroutine is first resumed
+    static InterpretResult coroutine(VM &vm)
+    {
+        Value value = vm.pop();
+
+        auto fn = value.get<Function>();
+
+        if(!fn || !fn->is(ObjectType::Function))
+            return vm.runtime_error("coroutine expects a function");
+
+        vm.m_stack.emplace_back(new Coroutine(std::move(*fn)));
+
+        return InterpretResult::Ok;
+    }
+
+    // spawn takes the function and up to this many arguments for it
+    constexpr uint8_t MaxSpawnArgs = 8;
+
+    // runs the function on the worker pool, the arguments and the globals it sees are copies
+    static InterpretResult spawn(VM &vm)
+    {
+        Value value = vm.pop();
+
+        // arguments that were not passed are nil, the function only gets as many as it takes
+        std::vector<Value> args;
+
+        for(uint8_t i = 0; i < MaxSpawnArgs; i++)
+            args.push_back(vm.pop());
+
+        auto fn = value.get<Function>();
+
+        if(!fn || !fn->is(ObjectType::Function))
+            return vm.runtime_error("spawn expects a function");
+
+        if(fn->param_count > MaxSpawnArgs)
+            return vm.runtime_error("spawned functions take at most 8 arguments");
+
+        args.resize(fn->param_count);
+
+        auto function = scheduler::isolate(value);
+
+        if(!function.has_value())
+            return vm.runtime_error("function cannot be passed to another thread");
+
+        for(auto &arg : args)
+        {
+            auto copy = scheduler::isolate(arg);
+
+            if(!copy.has_value())
+                return vm.runtime_error("argument cannot be passed to another thread");
+
+            arg = std::move(copy.value());
+        }
+
+        // globals that cannot leave this vm, like a module, are nil for the task
+        std::vector<Value> globals = vm.globals();
+
+        for(auto &global : globals)
+            global = scheduler::isolate(global).value_or(Value(nullptr));
+
+        auto handle = scheduler::spawn(std::move(*function->get<Function>()), std::move(args), std::move(globals));
+
+        vm.m_stack.emplace_back(new Task(std::move(handle)));
+
+        return InterpretResult::Ok;
+    }
+
+    // waits for a task and evaluates to what its function returned
+    static InterpretResult await(VM &vm)
+    {
+        Value value = vm.pop();
+
+        auto task = value.get<Task>();
+
+        if(!task || !task->is(ObjectType::Task))
+            return vm.runtime_error("await expects a task");
+
+        // anything printed before waiting should not show up after what the task prints
+        vm.m_output.flush();
+
+        auto result = scheduler::await(task->handle);
+
+        if(!result.has_value())
+            return vm.runtime_error("awaited task failed");
+
+        vm.m_stack.push_back(std::move(result.value()));
+
+        return InterpretResult::Ok;
+    }
+
+    // a channel holding up to capacity values, rounded up to a power of two
+    static InterpretResult channel(VM &vm)
+    {
+        Value capacity = vm.pop();
+
+        if(capacity.type != ValueType::Int || capacity.as.integer <= 0)
+            return vm.runtime_error("channel expects a positive integer capacity");
+
+        vm.m_stack.emplace_back(new Channel(capacity.as.integer));
+
+        return InterpretResult::Ok;
+    }
+
+    static Channel* as_channel(const Value &value)
+    {
+        auto channel = value.get<Channel>();
+
+        return channel && channel->is(ObjectType::Channel) ? channel : nullptr;
+    }
+
+    // the value popped off the stack is already a copy only this vm has, so it is handed to the receiver as it
+    // is and only closures need their variables copied. blocks while the channel is full, a task that does hands
+    // its worker over to the rest of the pool
+    static InterpretResult send(VM &vm)
+    {
+        Value target = vm.pop();
+        Value value  = vm.pop();
+
+        auto channel = as_channel(target);
+
+        if(!channel)
+            return vm.runtime_error("send expects a channel");
+
+        if(!scheduler::detach(value))
+            return vm.runtime_error("value cannot be passed to another thread");
+
+        if(!channel->ring->try_send(value))
+        {
+            vm.m_output.flush();
+            scheduler::blocking([&] { channel->ring->send(std::move(value)); });
+        }
+
+        return InterpretResult::Ok;
+    }
+
+    // blocks until a value arrives
+    static InterpretResult recv(VM &vm)
+    {
+        Value value = vm.pop();
+
+        auto channel = as_channel(value);
+
+        if(!channel)
+            return vm.runtime_error("recv expects a channel");
+
+        Value received;
+
+        if(!channel->ring->try_recv(received))
+        {
+            vm.m_output.flush();
+            scheduler::blocking([&] { received = channel->ring->recv(); });
+        }
+
+        vm.m_stack.push_back(std::move(received));
+
+        return InterpretResult::Ok;
+    }
+
+    // evaluates to the next value and true, or nil and false when the channel is empty
+    static InterpretResult try_recv(VM &vm)
+    {
+        Value value = vm.pop();
+
+        auto channel = as_channel(value);
+
+        if(!channel)
+            return vm.runtime_error("try_recv expects a channel");
+
+        Value received;
+
+        bool ok = channel->ring->try_recv(received);
+
+        auto tuple = new Tuple(2);
+
+        tuple->data.push_back(std::move(received));
+        tuple->data.emplace_back(ok);
 
-        mio::print(message.to_string() + '\n');
+        vm.m_stack.emplace_back(tuple);
 
         return InterpretResult::Ok;
     }
+
+    // starts fn with argument on the next loop(), its io lets other async calls run instead of blocking
+    static InterpretResult async(VM &vm)
+    {
+        Value value    = vm.pop();
+        Value argument = vm.pop();
+
+        auto fn = value.get<Function>();
+
+        if(!fn || !fn->is(ObjectType::Function))
+            return vm.runtime_error("async expects a function");
+
+        auto fiber = std::make_shared<Fiber>(std::move(*fn));
+
+        fiber->async = true;
+
+        vm.events().queue(std::move(fiber), std::move(argument));
+
+        return InterpretResult::Ok;
+    }
+
+    // runs async calls until every one of them is done, including the ones they start
+    static InterpretResult loop(VM &vm)
+    {
+        if(vm.m_fiber && vm.m_fiber->async)
+            return vm.runtime_error("loop cannot be run from an async call");
+
+        return vm.events().run(vm);
+    }
+
+    static bool as_descriptor(const Value &value, int &fd)
+    {
+        if(value.type != ValueType::Int || value.as.integer < 0 || value.as.integer > INT32_MAX)
+            return false;
+
+        fd = value.as.integer;
+
+        return true;
+    }
+
+    // descriptors are ints, the io builtins give back nil when something fails
+
+    static InterpretResult pipe(VM &vm)
+    {
+        vm.m_stack.push_back(events::pipe());
+
+        return InterpretResult::Ok;
+    }
+
+    static InterpretResult open(VM &vm)
+    {
+        Value path = vm.pop();
+        Value mode = vm.pop();
+
+        auto string = path.get<String>();
+
+        if(!string || !string->is(ObjectType::String))
+            return vm.runtime_error("open expects a path");
+
+        vm.m_stack.push_back(events::open(string->data, mode.type == ValueType::Nil ? "r" : mode.to_string()));
+
+        return InterpretResult::Ok;
+    }
+
+    // what is available up to 64kb, an empty string once the other end is closed
+    static InterpretResult read(VM &vm)
+    {
+        int fd;
+
+        if(!as_descriptor(vm.pop(), fd))
+            return vm.runtime_error("read expects a descriptor");
+
+        vm.events().perform(vm, fd, EventLoop::Direction::Read, [fd] { return events::read(fd); });
+
+        return vm.m_state;
+    }
+
+    // writes all of data and evaluates to how many bytes that was
+    static InterpretResult write(VM &vm)
+    {
+        Value target = vm.pop();
+        Value data   = vm.pop();
+
+        int fd;
+
+        if(!as_descriptor(target, fd))
+            return vm.runtime_error("write expects a descriptor");
+
+        auto string = data.get<String>();
+
+        std::string bytes = string && string->is(ObjectType::String) ? std::move(string->data) : data.to_string();
+
+        vm.events().perform(vm, fd, EventLoop::Direction::Write, events::write(fd, std::move(bytes)));
+
+        return vm.m_state;
+    }
+
+    static InterpretResult close(VM &vm)
+    {
+        int fd;
+
+        if(!as_descriptor(vm.pop(), fd))
+            return vm.runtime_error("close expects a descriptor");
+
+        vm.events().forget(fd);
+        events::close(fd);
+
+        return InterpretResult::Ok;
+    }
+
+    static InterpretResult listen(VM &vm)
+    {
+        Value host = vm.pop();
+        Value port = vm.pop();
+
+        if(port.type != ValueType::Int)
+            return vm.runtime_error("listen expects a host and a port");
+
+        vm.m_stack.push_back(events::listen(host.to_string(), port.as.integer));
+
+        return InterpretResult::Ok;
+    }
+
+    static InterpretResult port(VM &vm)
+    {
+        int fd;
+
+        if(!as_descriptor(vm.pop(), fd))
+            return vm.runtime_error("port expects a descriptor");
+
+        vm.m_stack.push_back(events::port(fd));
+
+        return InterpretResult::Ok;
+    }
+
+    static InterpretResult accept(VM &vm)
+    {
+        int fd;
+
+        if(!as_descriptor(vm.pop(), fd))
+            return vm.runtime_error("accept expects a descriptor");
+
+        vm.events().perform(vm, fd, EventLoop::Direction::Read, [fd] { return events::accept(fd); });
+
+        return vm.m_state;
+    }
+
+    static InterpretResult connect(VM &vm)
+    {
+        Value host = vm.pop();
+        Value port = vm.pop();
+
+        if(port.type != ValueType::Int)
+            return vm.runtime_error("connect expects a host and a port");
+
+        int fd = events::connect(host.to_string(), port.as.integer);
+
+        if(fd == -1)
+        {
+            vm.m_stack.emplace_back(nullptr);
+            return InterpretResult::Ok;
+        }
+
+        vm.events().perform(vm, fd, EventLoop::Direction::Write, [fd] { return events::connected(fd); });
+
+        return vm.m_state;
+    }
+
+    // every native scripts can call by name, the compiler registers them as globals
+    // and cached programs look them up here by name when they are loaded. never destroyed since tasks still
+    // running when the program ends keep calling natives until the process is gone
+    inline std::vector<NativeFunction>& natives()
+    {
+        static auto &table = *new std::vector<NativeFunction>
+        {
+            NativeFunction("panic", 1, panic),
+            NativeFunction("input", 1, input),
+            NativeFunction("print", 1, print),
+            NativeFunction("println", 1, println),
+            NativeFunction("flush", 0, flush),
+            NativeFunction("coroutine", 1, coroutine),
+            NativeFunction("spawn", 1 + MaxSpawnArgs, spawn),
+            NativeFunction("await", 1, await),
+            NativeFunction("channel", 1, channel),
+            NativeFunction("send", 2, send),
+            NativeFunction("recv", 1, recv),
+            NativeFunction("try_recv", 1, try_recv),
+            NativeFunction("async", 2, async),
+            NativeFunction("loop", 0, loop),
+            NativeFunction("pipe", 0, pipe),
+            NativeFunction("open", 2, open),
+            NativeFunction("read", 1, read),
+            NativeFunction("write", 2, write),
+            NativeFunction("close", 1, close),
+            NativeFunction("listen", 2, listen),
+            NativeFunction("port", 1, port),
+            NativeFunction("accept", 1, accept),
+            NativeFunction("connect", 2, connect),
+        };
+
+        return table;
+    }
+
+    // adds a native for every compiler made from now on, one with the same name is replaced.
+    // natives are only read once compiling starts so hosts define theirs before that
+    inline void define(std::string_view name, uint8_t param_count, NativeFunction::FN fn)
+    {
+        // natives only keep a view of their name, kept as long as the table
+        static auto &names = *new std::deque<std::string>;
+
+        auto &table = natives();
+
+        for(auto &native : table)
+        {
+            if(native.name == name)
+            {
+                native = NativeFunction(native.name, param_count, fn);
+                return;
+            }
+        }
+
+        table.emplace_back(names.emplace_back(name), param_count, fn);
+    }
 }
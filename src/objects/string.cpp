@@ -1,7 +1,5 @@
 #include "string.hpp"
 
-std::unordered_map<std::string_view, Object*> String::intern_strings;
-
 bool String::compare(const Object *obj)
 {
     if(obj->type() != ObjectType::String)
@@ -9,11 +7,8 @@ bool String::compare(const Object *obj)
 
     auto str = static_cast<const String*>(obj);
 
-    // compares object pointers to do constant time string comparisons
-    auto s1 = intern_strings.find(str->data);
-    auto s2 = intern_strings.find(data);
-
-    return s1 == s2;
+    // the cached hashes tell most unequal strings apart without looking at their contents
+    return hash == str->hash && data == str->data;
 }
 
 Object *String::add(const Object *obj)
@@ -27,6 +22,7 @@ Object *String::plus_equal(const Object *obj)
     auto str = static_cast<const String*>(obj);
 
     data += str->data;
+    hash  = hash_of(data);
 
     return this;
 }
\ No newline at end of file
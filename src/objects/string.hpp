@@ -6,23 +6,23 @@ struct String : Object
 {
     // this is fairly safe as it will never attempt to mutate the data if it is set as static
     String(std::string_view sv) :
-          data(sv)
-    {
-        intern_strings.emplace(sv, this);
-    }
+          data(sv),
+          hash(hash_of(sv))
+    {}
 
     String(std::string &&string) :
-        data(std::forward<std::string>(string))
-    {
-        intern_strings.emplace(data, this);
-    }
+        data(std::forward<std::string>(string)),
+        hash(hash_of(data))
+    {}
 
     String(String &&string) noexcept :
-        data(std::move(string.data))
+        data(std::move(string.data)),
+        hash(string.hash)
     {}
 
     String(const String &string) :
-        data(string.data)
+        data(string.data),
+        hash(string.hash)
     {}
 
     Object* clone() override
@@ -51,8 +51,13 @@ struct String : Object
         return ObjectType::String;
     }
 
+    static size_t hash_of(std::string_view sv)
+    {
+        return std::hash<std::string_view>{}(sv);
+    }
+
     std::string data;
 
-    // this static map is used for string interning
-    static std::unordered_map<std::string_view, Object*> intern_strings;
-};
\ No newline at end of file
+    // cached on construction (and kept up to date by mutations) so hashed containers never rehash the contents
+    size_t hash;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../types/object.hpp"
+#include "../scheduler.hpp"
+
+// what spawn returns, await gives back the result of the task. copies refer to the same task
+struct Task : Object
+{
+    scheduler::Handle handle;
+
+    Task(scheduler::Handle handle) :
+        handle(std::move(handle))
+    {}
+
+    Task(const Task &task) = default;
+
+    Task(Task &&task) = default;
+
+    Object* clone() override
+    {
+        return new Task(*this);
+    }
+
+    Object* move() override
+    {
+        return new Task(std::move(*this));
+    }
+
+    ObjectType type() const override
+    {
+        return ObjectType::Task;
+    }
+
+    std::string to_string() const override
+    {
+        return "task";
+    }
+
+    bool compare(const Object *obj) override
+    {
+        return obj->type() == ObjectType::Task && static_cast<const Task*>(obj)->handle == handle;
+    }
+};
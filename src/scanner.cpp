@@ -1,39 +1,18 @@
 
 #include <cctype>
-#include <unordered_map>
+#include <cerrno>
+#include <unordered_set>
+#include <mutex>
 #include <iostream>
 
+#include <unistd.h>
+
 #include "scanner.hpp"
+#include "util/simd.hpp"
+#include "types/keywords.hpp"
 
 using enum TokenType;
 
-static const std::unordered_map<std::string_view, TokenType> g_keywords =
-{
-        {"and",      And},
-        {"obj",      Obj},
-        {"else",     Else},
-        {"false",    False},
-        {"true",     True},
-        {"for",      For},
-        {"fn",       Fn},
-        {"if",       If},
-        {"do",       Do},
-        {"nil",      Nil},
-        {"or",       Or},
-        {"return",   Return},
-        {"super",    Super},
-        {"this",     This},
-        {"var",      Var},
-        {"const",    Const},
-        {"is",       Is},
-        {"in",       In},
-        {"while",    While},
-        {"switch",   Switch},
-        {"continue", Continue},
-        {"break",    Break},
-        {"default",  Default},
-};
-
 Token Scanner::scan_token()
 {
     // if the last token was a return and it found a new line its an indication that a terminator should be built
@@ -53,6 +32,8 @@ Token Scanner::scan_token()
         case ')':  return  build(RightParen);
         case '{':  return  build(LeftBrace);
         case '}':  return  build(RightBrace);
+        case '[':  return  build(LeftBracket);
+        case ']':  return  build(RightBracket);
         case ',':  return  build(Comma);
         case '-':
         {
@@ -78,11 +59,14 @@ Token Scanner::scan_token()
         case ':':  return  build(Colon);
         case '%':  return  build(Percent);
         case '^':  return  build(Caret);
+        case '&':  return  build(Ampersand);
+        case '|':  return  build(Pipe);
+        case '~':  return  build(Tilde);
 
         case '!': return build(match('=') ? BangEqual : Bang);
         case '=': return build(match('=') ? EqualEqual : Equal);
-        case '>': return build(match('=') ? GreaterEqual: Greater);
-        case '<': return build(match('=') ? LessEqual : Less);
+        case '>': return build(match('>') ? GreaterGreater : match('=') ? GreaterEqual : Greater);
+        case '<': return build(match('<') ? LessLess : match('=') ? LessEqual : Less);
         case '.': return build(match('.') ? DotDot : Dot);
 
         case 'f':
@@ -128,8 +112,7 @@ Token Scanner::scan_fstring()
         }
         else
         {
-            while(!at_end() && (peek() != '{' && peek() != '"'))
-                advance();
+            skip_run([](std::string_view text, size_t from) { return simd::find_either(text, from, '{', '"'); });
 
             return build(String);
         }
@@ -145,10 +128,14 @@ Token Scanner::scan_fstring()
 
 Token Scanner::scan_string()
 {
-    while(!at_end() && peek() != '"')
+    while(true)
     {
-        if(peek() == '\n')
-            m_line++;
+        skip_run([](std::string_view text, size_t from) { return simd::find_either(text, from, '"', '\n'); });
+
+        if(at_end() || peek() == '"')
+            break;
+
+        m_line++;
         advance();
     }
 
@@ -169,6 +156,17 @@ Token Scanner::scan_string()
 
 Token Scanner::scan_number()
 {
+    // hex and binary literals, the compiler strips the prefix
+    if(m_source[m_start] == '0' && (peek() == 'x' || peek() == 'b') && isxdigit(peek_next()))
+    {
+        advance();
+
+        while(isxdigit(peek()))
+            advance();
+
+        return build(Integer);
+    }
+
     while(isdigit(peek()))
         advance();
 
@@ -178,34 +176,34 @@ Token Scanner::scan_number()
 
         while(isdigit(peek()) )
             advance();
+
+        return build(Number);
     }
 
-    return build(Number);
+    return build(Integer);
 }
 
 Token Scanner::scan_identifier()
 {
-    while(is_alpha(peek()) || isdigit(peek()))
-        advance();
+    skip_run(simd::skip_identifier);
 
     std::string_view text = m_source.substr(m_start, m_offset - m_start);
 
-    TokenType type = !g_keywords.contains(text) ? Identifier : g_keywords.at(text);
-
-    return build(type);
+    return build(keywords::type_of(text));
 }
 
 bool Scanner::skip_chars()
 {
     char c;
 
-    while((c = peek()))
+    // skipped chars are never part of a lexeme so a streaming scanner can drop them
+    for(m_start = m_offset; (c = peek()) != '\0'; m_start = m_offset)
     {
         switch(c)
         {
             case ' ':
             case '\r':
-            case '\t': advance(); break;
+            case '\t': skip_run(simd::skip_blanks); break;
             case '\n':
             {
                 m_line++;
@@ -221,8 +219,7 @@ bool Scanner::skip_chars()
             {
                 if(match_next('/'))
                 {
-                    while(!at_end() && peek() != '\n')
-                        advance();
+                    skip_run([](std::string_view text, size_t from) { return simd::find_either(text, from, '\n', '\n'); });
                     if(peek() == '\n')
                         m_line++;
                 }
@@ -253,14 +250,18 @@ bool Scanner::skip_chars()
                 return false;
         }
     }
+
+    return false;
 }
 
 inline Token Scanner::build(TokenType kind)
 {
+    std::string_view lexeme = m_source.substr(m_start, m_offset - m_start);
+
     Token token =
     {
         .type   = kind,
-        .lexeme = m_source.substr(m_start, m_offset - m_start),
+        .lexeme = is_streaming() ? intern(lexeme) : lexeme,
         .line   = m_line,
         .column = m_column
     };
@@ -270,9 +271,53 @@ inline Token Scanner::build(TokenType kind)
     return token;
 }
 
-inline bool Scanner::at_end() const
+bool Scanner::fill(size_t count)
 {
-    return m_offset >= m_source.size();
+    while(m_offset + count > m_source.size() && is_streaming() && !m_input_done)
+    {
+        // everything before the current token has been handed out already
+        m_buffer.erase(0, m_start);
+
+        m_discarded += m_start;
+        m_offset    -= m_start;
+        m_start      = 0;
+
+        size_t size = m_buffer.size();
+
+        m_buffer.resize(size + BlockSize);
+
+        ssize_t result;
+
+        while((result = ::read(m_fd, m_buffer.data() + size, BlockSize)) < 0 && errno == EINTR);
+
+        if(result <= 0)
+        {
+            m_input_done = true;
+            result = 0;
+        }
+
+        m_buffer.resize(size + result);
+        m_source = m_buffer;
+    }
+
+    return m_offset + count <= m_source.size();
+}
+
+// lexemes are kept for the life of the program since identifiers and function names refer to them
+std::string_view Scanner::intern(std::string_view lexeme)
+{
+    static std::unordered_set<std::string> lexemes;
+    // shared by every streaming compiler in the process
+    static std::mutex mutex;
+
+    std::lock_guard lock(mutex);
+
+    return *lexemes.emplace(lexeme).first;
+}
+
+inline bool Scanner::at_end()
+{
+    return m_offset >= m_source.size() && !fill(1);
 }
 
 inline char Scanner::advance()
@@ -297,7 +342,7 @@ inline bool Scanner::match(char c)
 
 bool Scanner::match_next(char c)
 {
-    if(at_end())
+    if(m_offset+1 >= m_source.size() && !fill(2))
         return false;
     if(m_source[m_offset+1] != c)
         return false;
@@ -307,16 +352,16 @@ bool Scanner::match_next(char c)
     return true;
 }
 
-inline char Scanner::peek() const
+inline char Scanner::peek()
 {
     if(at_end())
         return '\0';
     return m_source[m_offset];
 }
 
-inline char Scanner::peek_next() const
+inline char Scanner::peek_next()
 {
-    if(m_offset+1 >= m_source.size())
+    if(m_offset+1 >= m_source.size() && !fill(2))
         return '\0';
     return m_source[m_offset+1];
 }
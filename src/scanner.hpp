@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <string_view>
 
 #include "types/token.hpp"
@@ -14,10 +15,53 @@ public:
         m_source(source)
     {}
 
+    // reads the source from fd a block at a time as it is scanned so it never has to be in memory all at once.
+    // lexemes are interned since the block they were read from gets reused
+    explicit Scanner(int fd)
+    :
+        m_fd(fd)
+    {}
+
+    // the size of the blocks read in streaming mode
+    static constexpr size_t BlockSize = 64 * 1024;
+
+    bool is_streaming() const
+    {
+        return m_fd >= 0;
+    }
+
     Token scan_token();
 
     Token scan_fstring();
 
+    struct Position
+    {
+        size_t offset;
+        size_t line;
+        size_t column;
+    };
+
+    // used to come back to a part of the source later, like the body of a lazily compiled function.
+    // a streaming scanner has already dropped what it scanned so it cannot seek back to it
+    Position position() const
+    {
+        return {m_discarded + m_offset, m_line, m_column};
+    }
+
+    std::string_view source() const
+    {
+        return m_source;
+    }
+
+    void seek(Position position)
+    {
+        m_offset = position.offset;
+        m_start  = position.offset;
+        m_line   = position.line;
+        m_column = position.column;
+        m_in_fstring_brace = false;
+    }
+
     struct State
     {
         uint32_t line;
@@ -32,8 +76,15 @@ private:
     size_t   m_line   = 1;
     size_t   m_column = 1;
 
+    // the whole source, or the part of the block buffer still being scanned when streaming
     std::string_view m_source;
 
+    int m_fd = -1;
+    bool m_input_done = false;
+    std::string m_buffer;
+    // how much of the input was dropped from the front of the buffer
+    size_t m_discarded = 0;
+
     Token m_last;
 
     bool m_in_fstring_brace = false;
@@ -47,12 +98,33 @@ private:
     Token scan_number();
     Token scan_identifier();
 
-    bool at_end() const;
+    // reads blocks until count chars past the offset are buffered, false if the input ends first
+    bool fill(size_t count);
+
+    static std::string_view intern(std::string_view lexeme);
+
+    // moves to the end of the run one of the simd helpers finds, searching again after a streaming scanner refills
+    template<typename Find>
+    void skip_run(Find find)
+    {
+        while(true)
+        {
+            size_t end = find(m_source, m_offset);
+
+            m_column += end - m_offset;
+            m_offset  = end;
+
+            if(end < m_source.size() || !fill(1))
+                return;
+        }
+    }
+
+    bool at_end();
     char advance();
     bool match(char c);
     bool match_next(char c);
-    char peek() const;
-    char peek_next() const;
+    char peek();
+    char peek_next();
     bool is_alpha(char c) const;
 
     void error(std::string_view message);
@@ -0,0 +1,416 @@
+#include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+#include "scheduler.hpp"
+#include "vm.hpp"
+#include "objects/tuple.hpp"
+#include "objects/map.hpp"
+
+namespace
+{
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<scheduler::Handle> tasks;
+        std::thread thread;
+
+        // whether the worker is in the middle of a task, and whether it has left its loop for good
+        std::atomic<bool> running = false;
+        std::atomic<bool> exited  = false;
+    };
+
+    // workers the pool may grow to while some of them are blocked
+    constexpr size_t MaxWorkers = 256;
+
+    struct Pool
+    {
+        // one per core to start with, the array never moves so workers can be added while others look at them
+        std::array<std::unique_ptr<Worker>, MaxWorkers> workers;
+        std::atomic<size_t> worker_count = 0;
+        size_t parallelism;
+
+        // workers stuck in a blocking operation like a full channel, and workers asleep waiting for tasks
+        std::atomic<size_t> blocked = 0;
+        size_t idle = 0;
+
+        // tasks queued on any deque, workers sleep while it is zero
+        std::atomic<size_t> queued = 0;
+        // spreads tasks spawned outside the pool over the workers
+        std::atomic<size_t> next = 0;
+
+        std::mutex sleep_mutex;
+        std::condition_variable wake;
+        std::atomic<bool> stopping = false;
+
+        Pool();
+
+        // drops the tasks nobody started and lets every idle worker finish. a task that is still running when
+        // the program ends may never finish, like one waiting on a channel nobody sends to, so its worker is
+        // left to the process exiting rather than joined
+        void stop();
+
+        void push(scheduler::Handle &&task);
+
+        // starts another worker if tasks are queued while blocked workers leave fewer than one per core running
+        void compensate();
+
+        // the newest task of the worker or the oldest task of any other one
+        scheduler::Handle take(size_t worker);
+
+        void work(size_t index);
+    };
+
+    // the worker the current thread is, or -1 outside the pool
+    thread_local size_t t_worker = -1;
+
+    // a task awaiting another one can end up running it on the same thread so each level gets a vm of its own
+    thread_local std::vector<std::unique_ptr<VM>> t_vms;
+    thread_local size_t t_depth = 0;
+
+    Pool &pool()
+    {
+        // never destroyed since workers still running a task at exit keep using it
+        static Pool *pool = new Pool;
+
+        static struct Stop
+        {
+            ~Stop() { pool->stop(); }
+        } stop;
+
+        return *pool;
+    }
+
+    void run(scheduler::Job &job)
+    {
+        if(t_depth == t_vms.size())
+            t_vms.push_back(std::make_unique<VM>());
+
+        VM &vm = *t_vms[t_depth++];
+
+        InterpretResult status = vm.invoke(std::move(job.function), std::move(job.args), std::move(job.globals));
+
+        std::optional<Value> result;
+
+        if(status == InterpretResult::Ok)
+            result = scheduler::isolate(vm.pop());
+
+        vm.m_output.flush();
+
+        t_depth--;
+
+        {
+            std::lock_guard lock(job.mutex);
+
+            job.failed = !result.has_value();
+
+            if(result.has_value())
+                job.result = std::move(result.value());
+
+            job.done = true;
+        }
+
+        job.finished.notify_all();
+    }
+
+    Pool::Pool() :
+        parallelism(std::max(std::thread::hardware_concurrency(), 1u))
+    {
+        for(size_t i = 0; i < parallelism; i++)
+            workers[i] = std::make_unique<Worker>();
+
+        worker_count = parallelism;
+
+        for(size_t i = 0; i < parallelism; i++)
+            workers[i]->thread = std::thread(&Pool::work, this, i);
+    }
+
+    void Pool::stop()
+    {
+        {
+            std::lock_guard lock(sleep_mutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        size_t count = worker_count;
+
+        // every worker either leaves its loop or is in a task it may never get out of
+        auto settled = [&]
+        {
+            for(size_t i = 0; i < count; i++)
+            {
+                if(!workers[i]->exited && !workers[i]->running)
+                    return false;
+            }
+
+            return true;
+        };
+
+        while(!settled())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        for(size_t i = 0; i < count; i++)
+        {
+            if(workers[i]->exited)
+                workers[i]->thread.join();
+            else
+                workers[i]->thread.detach();
+        }
+    }
+
+    void Pool::push(scheduler::Handle &&task)
+    {
+        size_t index = t_worker != (size_t)-1 ? t_worker : next++ % parallelism;
+
+        {
+            std::lock_guard lock(workers[index]->mutex);
+            workers[index]->tasks.push_back(std::move(task));
+        }
+
+        {
+            std::lock_guard lock(sleep_mutex);
+            queued++;
+        }
+
+        wake.notify_one();
+
+        if(blocked > 0)
+            compensate();
+    }
+
+    void Pool::compensate()
+    {
+        std::lock_guard lock(sleep_mutex);
+
+        size_t count = worker_count;
+
+        if(stopping || queued == 0 || idle > 0 || count - blocked >= parallelism || count == MaxWorkers)
+            return;
+
+        workers[count] = std::make_unique<Worker>();
+        worker_count   = count + 1;
+
+        workers[count]->thread = std::thread(&Pool::work, this, count);
+    }
+
+    scheduler::Handle Pool::take(size_t worker)
+    {
+        if(queued == 0)
+            return nullptr;
+
+        size_t count = worker_count;
+
+        // outside the pool every deque is someone elses
+        bool own = worker < count;
+
+        for(size_t i = 0; i < count; i++)
+        {
+            size_t index = own ? (worker + i) % count : i;
+
+            std::lock_guard lock(workers[index]->mutex);
+
+            auto &tasks = workers[index]->tasks;
+
+            if(tasks.empty())
+                continue;
+
+            scheduler::Handle task;
+
+            if(own && i == 0)
+            {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            queued--;
+
+            return task;
+        }
+
+        return nullptr;
+    }
+
+    void Pool::work(size_t index)
+    {
+        t_worker = index;
+
+        Worker &worker = *workers[index];
+
+        while(!stopping)
+        {
+            if(auto task = take(index))
+            {
+                worker.running = true;
+                run(*task);
+                worker.running = false;
+
+                continue;
+            }
+
+            std::unique_lock lock(sleep_mutex);
+
+            idle++;
+            wake.wait(lock, [this] { return stopping || queued > 0; });
+            idle--;
+        }
+
+        worker.exited = true;
+    }
+
+    // the copies made of each upvalue so far, closures sharing a variable keep sharing the copy
+    // and a closure that captured itself does not copy itself forever
+    using UpvalueCopies = std::unordered_map<const Upvalue*, std::shared_ptr<Upvalue>>;
+
+    bool detach(Value &value, UpvalueCopies &copies)
+    {
+        if(value.type == ValueType::Address)
+            return false;
+
+        if(value.type != ValueType::Object)
+            return true;
+
+        switch(value.as.object->type())
+        {
+            case ObjectType::Tuple:
+            {
+                for(auto &element : value.get<Tuple>()->data)
+                {
+                    if(!detach(element, copies))
+                        return false;
+                }
+
+                return true;
+            }
+            case ObjectType::Map:
+            {
+                for(auto &bucket : value.get<Map>()->buckets)
+                {
+                    if(bucket.distance != 0 && !detach(bucket.value, copies))
+                        return false;
+                }
+
+                return true;
+            }
+            case ObjectType::Function:
+            {
+                auto fn = value.get<Function>();
+
+                if(fn->globals)
+                    return false;
+
+                for(auto &upvalue : fn->upvalues)
+                {
+                    auto [it, inserted] = copies.emplace(upvalue.get(), nullptr);
+
+                    if(inserted)
+                    {
+                        it->second = std::make_shared<Upvalue>(nullptr);
+
+                        auto &copy = *it->second;
+
+                        copy.closed   = *upvalue->location;
+                        copy.location = &copy.closed;
+
+                        if(!detach(copy.closed, copies))
+                            return false;
+                    }
+
+                    upvalue = it->second;
+                }
+
+                return true;
+            }
+            case ObjectType::Coroutine:
+                return false;
+            default:
+                return true;
+        }
+    }
+}
+
+bool scheduler::detach(Value &value)
+{
+    UpvalueCopies copies;
+
+    return ::detach(value, copies);
+}
+
+std::optional<Value> scheduler::isolate(const Value &value)
+{
+    Value copy = value;
+
+    if(!detach(copy))
+        return std::nullopt;
+
+    return copy;
+}
+
+size_t scheduler::worker_count()
+{
+    return pool().parallelism;
+}
+
+void scheduler::blocking(const std::function<void()> &wait)
+{
+    if(t_worker == (size_t)-1)
+        return wait();
+
+    Pool &pool = ::pool();
+
+    pool.blocked++;
+    pool.compensate();
+
+    wait();
+
+    pool.blocked--;
+}
+
+scheduler::Handle scheduler::spawn(Function &&function, std::vector<Value> &&args, std::vector<Value> &&globals)
+{
+    auto job = std::make_shared<Job>();
+
+    job->function = std::move(function);
+    job->args     = std::move(args);
+    job->globals  = std::move(globals);
+
+    pool().push(Handle(job));
+
+    return job;
+}
+
+std::optional<Value> scheduler::await(const Handle &handle)
+{
+    Job &job = *handle;
+
+    while(!job.done)
+    {
+        if(auto task = pool().take(t_worker))
+        {
+            run(*task);
+            continue;
+        }
+
+        // a task that finishes notifies its own waiters but new tasks do not, so this wakes up now and then
+        // to look for work again
+        std::unique_lock lock(job.mutex);
+
+        job.finished.wait_for(lock, std::chrono::milliseconds(1), [&] { return job.done.load(); });
+    }
+
+    std::lock_guard lock(job.mutex);
+
+    if(job.failed)
+        return std::nullopt;
+
+    return isolate(job.result);
+}
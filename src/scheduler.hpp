@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "objects/function.hpp"
+
+/*
+ * spawn runs a function on a pool of worker threads, one per core. every worker has a deque of its own,
+ * it takes its newest task first and steals the oldest one of another worker when it runs out, tasks spawned
+ * by a task go to the deque of the worker running it. a task runs on a vm of the thread that picked it up with
+ * a copy of the spawners globals, so tasks share bytecode with the program but never any values.
+ * a worker blocked on something another task has to do, like a full channel, does not count as one of the
+ * running workers and the pool starts another thread for queued tasks, so chains of tasks longer than there
+ * are cores still make progress
+ */
+namespace scheduler
+{
+    struct Job
+    {
+        Function function;
+        std::vector<Value> args;
+        std::vector<Value> globals;
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::atomic<bool> done = false;
+        bool failed = false;
+        Value result;
+    };
+
+    using Handle = std::shared_ptr<Job>;
+
+    /*
+     * a copy of value that shares nothing with the vm it came from, so it can be handed to another thread.
+     * closures get copies of the variables they captured. nullopt for what only makes sense in its own vm,
+     * addresses, coroutines and functions bound to the globals of a module
+     */
+    std::optional<Value> isolate(const Value &value);
+
+    // isolate for a value that is already a private copy, like one popped off the stack. it is made independent
+    // of its vm in place so strings, tuples and maps are handed over as they are without copying them again
+    bool detach(Value &value);
+
+    // the number of workers the pool keeps running, one per core
+    size_t worker_count();
+
+    // runs wait, which blocks until another task does something. on a worker the pool starts a spare one
+    // meanwhile if tasks are queued so the task being waited for is not stuck behind this one
+    void blocking(const std::function<void()> &wait);
+
+    // queues the call, the arguments and globals must already be isolated
+    Handle spawn(Function &&function, std::vector<Value> &&args, std::vector<Value> &&globals);
+
+    // blocks until the task is done, running queued tasks in the meantime so tasks awaiting tasks cannot starve
+    // the pool. nullopt if the task failed with an error, it has already been reported
+    std::optional<Value> await(const Handle &handle);
+}
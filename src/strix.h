@@ -0,0 +1,96 @@
+#ifndef STRIX_H
+#define STRIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * the c interface to strix for hosts that cannot use the c++ header. a vm loads one program, runs its top level
+ * and keeps its functions so the host can call them by name as often as it wants. arguments and results go
+ * through the vms stack, a call with ints, numbers, bools or nils as arguments does not allocate.
+ * errors are reported on stderr like they are for scripts, the functions only say whether something failed
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct strix_vm strix_vm;
+
+// a function of the loaded program, valid until the next load on the same vm
+typedef struct strix_function strix_function;
+
+typedef enum
+{
+    STRIX_OK,
+    STRIX_COMPILE_ERROR,
+    STRIX_RUNTIME_ERROR,
+} strix_result;
+
+typedef enum
+{
+    STRIX_NIL,
+    STRIX_BOOL,
+    STRIX_INT,
+    STRIX_NUMBER,
+    STRIX_STRING,
+    // tuples, maps, functions and everything else scripts can make
+    STRIX_OBJECT,
+} strix_type;
+
+strix_vm *strix_new(void);
+
+void strix_free(strix_vm *vm);
+
+// compiles source and runs its top level, main is not called. a program that was loaded before is replaced
+strix_result strix_load(strix_vm *vm, const char *source, size_t length);
+
+// like strix_load but uses the cached bytecode next to the file if it is still valid and writes it otherwise
+strix_result strix_load_file(strix_vm *vm, const char *path);
+
+// a global function of the loaded program, NULL if there is none with that name
+strix_function *strix_find(strix_vm *vm, const char *name);
+
+// calls the function with the top arg_count values as arguments, the first one pushed first.
+// the arguments are replaced by what it returned, a call that fails leaves the stack as it was without them
+strix_result strix_call(strix_vm *vm, strix_function *function, uint8_t arg_count);
+
+void strix_push_nil(strix_vm *vm);
+
+void strix_push_bool(strix_vm *vm, int value);
+
+void strix_push_int(strix_vm *vm, int64_t value);
+
+void strix_push_number(strix_vm *vm, double value);
+
+void strix_push_string(strix_vm *vm, const char *string, size_t length);
+
+// how many values are on the stack
+size_t strix_depth(strix_vm *vm);
+
+// the type of the top value, the stack must not be empty for this or any of the pops
+strix_type strix_top(strix_vm *vm);
+
+void strix_pop(strix_vm *vm);
+
+// false for nil and false like a condition in a script
+int strix_pop_bool(strix_vm *vm);
+
+// 0 for anything that is not an integral number
+int64_t strix_pop_int(strix_vm *vm);
+
+// 0 for anything that is not a number
+double strix_pop_number(strix_vm *vm);
+
+// copies up to size bytes of the value as a string into buffer and returns its full length,
+// values that are not strings are formatted like print would
+size_t strix_pop_string(strix_vm *vm, char *buffer, size_t size);
+
+// writes out what scripts printed so far
+void strix_flush(strix_vm *vm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
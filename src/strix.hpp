@@ -0,0 +1,272 @@
+#pragma once
+
+#include <concepts>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "vm.hpp"
+#include "compiler.hpp"
+#include "objects/native_function.hpp"
+#include "objects/string.hpp"
+#include "util/fmt.hpp"
+
+/*
+ * the header for programs embedding strix. host functions are made callable from scripts with
+ * strix::define<fn>("name") before anything is compiled, fn is a function or a lambda without captures.
+ * its arity is the number of its parameters, the arguments are read straight from the slots the call left on the
+ * stack and what it returns is pushed back as the value of the call.
+ *
+ *   parameters   int64_t (or any other integer type), double, bool, std::string_view, const Value&, Value.
+ *                a first parameter of VM& is given the vm and is not an argument, the function can report an
+ *                error with vm.runtime_error and whatever it returned is dropped
+ *   results      void (the call has no value, like print), the same types as parameters, std::string,
+ *                const char* and std::optional of any of them, which is nil when empty
+ *
+ * a string_view only lives as long as the call and a Value parameter takes the argument over without copying it
+ */
+namespace strix
+{
+    namespace detail
+    {
+        template<typename T>
+        using Bare = std::remove_cvref_t<T>;
+
+        template<typename T>
+        concept Integer = std::integral<Bare<T>> && !std::same_as<Bare<T>, bool>;
+
+        template<typename T>
+        struct Argument;
+
+        template<Integer T>
+        struct Argument<T>
+        {
+            static constexpr std::string_view name = "an int";
+
+            static bool accepts(const Value &value)
+            {
+                int64_t integer;
+
+                return value.as_integer(integer) && std::in_range<Bare<T>>(integer);
+            }
+
+            static Bare<T> get(Value &value)
+            {
+                int64_t integer;
+
+                value.as_integer(integer);
+
+                return (Bare<T>)integer;
+            }
+        };
+
+        template<std::floating_point T>
+        struct Argument<T>
+        {
+            static constexpr std::string_view name = "a number";
+
+            static bool accepts(const Value &value)
+            {
+                return value.is_number();
+            }
+
+            static T get(Value &value)
+            {
+                return (T)value.as_double();
+            }
+        };
+
+        template<>
+        struct Argument<bool>
+        {
+            static constexpr std::string_view name = "a bool";
+
+            static bool accepts(const Value &value)
+            {
+                return value.type == ValueType::Bool;
+            }
+
+            static bool get(Value &value)
+            {
+                return value.as.boolean;
+            }
+        };
+
+        template<>
+        struct Argument<std::string_view>
+        {
+            static constexpr std::string_view name = "a string";
+
+            static bool accepts(const Value &value)
+            {
+                auto string = value.get<String>();
+
+                return string && string->is(ObjectType::String);
+            }
+
+            static std::string_view get(Value &value)
+            {
+                return value.get<String>()->data;
+            }
+        };
+
+        template<>
+        struct Argument<const Value&>
+        {
+            static constexpr std::string_view name = "a value";
+
+            static bool accepts(const Value&)
+            {
+                return true;
+            }
+
+            static Value& get(Value &value)
+            {
+                return value;
+            }
+        };
+
+        template<>
+        struct Argument<Value> : Argument<const Value&>
+        {
+            static Value get(Value &value)
+            {
+                return std::move(value);
+            }
+        };
+
+        // values taken by reference are the stack slot itself, anything else is read by its type
+        template<typename T>
+        using ArgumentOf = Argument<std::conditional_t<std::is_reference_v<T> && std::same_as<Bare<T>, Value>,
+                                                       const Value&, Bare<T>>>;
+
+        template<typename T>
+        Value to_value(T &&result)
+        {
+            using R = Bare<T>;
+
+            if constexpr(std::same_as<R, Value>)
+                return std::forward<T>(result);
+            else if constexpr(std::same_as<R, bool>)
+                return Value(result);
+            else if constexpr(Integer<R>)
+                return Value((int64_t)result);
+            else if constexpr(std::floating_point<R>)
+                return Value((double)result);
+            else if constexpr(std::same_as<R, std::string>)
+                return new String(std::string(std::forward<T>(result)));
+            else if constexpr(std::convertible_to<R, std::string_view>)
+                return new String(std::string_view(result));
+            else
+            {
+                static_assert(std::same_as<R, std::optional<typename R::value_type>>, "unsupported result type");
+
+                return result.has_value() ? to_value(std::move(*result)) : Value(nullptr);
+            }
+        }
+
+        template<typename Fn>
+        struct Signature;
+
+        template<typename R, typename... Args>
+        struct Signature<R(*)(Args...)>
+        {
+            using Result = R;
+
+            template<size_t... I>
+            static R invoke(auto fn, VM&, Value *args, std::index_sequence<I...>)
+            {
+                return fn(ArgumentOf<Args>::get(args[sizeof...(Args)-1-I])...);
+            }
+
+            template<size_t... I>
+            static bool check(VM &vm, const Value *args, std::index_sequence<I...>)
+            {
+                return (check_one<Args>(vm, args[sizeof...(Args)-1-I], I) && ...);
+            }
+
+            static constexpr size_t arity = sizeof...(Args);
+
+        private:
+            template<typename Arg>
+            static bool check_one(VM &vm, const Value &value, size_t index)
+            {
+                if(ArgumentOf<Arg>::accepts(value))
+                    return true;
+
+                vm.runtime_error(fmt::format("argument {} should be {}", index + 1, ArgumentOf<Arg>::name));
+
+                return false;
+            }
+        };
+
+        // the vm is passed ahead of the arguments and does not count towards the arity
+        template<typename R, typename... Args>
+        struct Signature<R(*)(VM&, Args...)> : Signature<R(*)(Args...)>
+        {
+            template<size_t... I>
+            static R invoke(auto fn, VM &vm, Value *args, std::index_sequence<I...>)
+            {
+                return fn(vm, ArgumentOf<Args>::get(args[sizeof...(Args)-1-I])...);
+            }
+        };
+
+        // the args are below the callee with the first one on top, set_fn_params already made their count the arity
+        template<auto F>
+        InterpretResult call(VM &vm)
+        {
+            using Fn = Signature<decltype(+F)>;
+            using R  = typename Fn::Result;
+
+            constexpr size_t arity = Fn::arity;
+            constexpr auto indices = std::make_index_sequence<arity>();
+
+            // the slots are found by index since a function that takes the vm may grow the stack
+            size_t base = vm.m_stack.size() - arity;
+
+            if(!Fn::check(vm, vm.m_stack.data() + base, indices))
+                return vm.m_state;
+
+            std::optional<Value> result;
+
+            if constexpr(std::is_void_v<R>)
+                Fn::invoke(+F, vm, vm.m_stack.data() + base, indices);
+            else
+                result = to_value(Fn::invoke(+F, vm, vm.m_stack.data() + base, indices));
+
+            vm.m_stack.erase(vm.m_stack.begin() + base, vm.m_stack.begin() + base + arity);
+
+            if(vm.m_state != InterpretResult::Ok)
+                return vm.m_state;
+
+            if(result.has_value())
+                vm.m_stack.push_back(std::move(result.value()));
+
+            return InterpretResult::Ok;
+        }
+    }
+
+    // how many arguments scripts pass to F
+    template<auto F>
+    constexpr size_t arity = detail::Signature<decltype(+F)>::arity;
+
+    // the native scripts call for F, for hosts that register natives by other means
+    template<auto F>
+    NativeFunction native(std::string_view name)
+    {
+        static_assert(arity<F> <= UINT8_MAX, "natives take at most 255 arguments");
+
+        return {name, (uint8_t)arity<F>, detail::call<F>};
+    }
+
+    // makes F callable from scripts compiled after this as name
+    template<auto F>
+    void define(std::string_view name)
+    {
+        static_assert(arity<F> <= UINT8_MAX, "natives take at most 255 arguments");
+
+        builtin::define(name, arity<F>, detail::call<F>);
+    }
+}
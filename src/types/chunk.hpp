@@ -25,6 +25,12 @@
     e(Divide)               \
     e(Power)                \
     e(Mod)                  \
+    e(BitAnd)               \
+    e(BitOr)                \
+    e(BitXor)               \
+    e(BitNot)               \
+    e(ShiftLeft)            \
+    e(ShiftRight)           \
     e(Not)                  \
     e(Negate)               \
     e(Increment)            \
@@ -32,23 +38,48 @@
     e(Or)                   \
     e(And)                  \
     e(LoadAddr)             \
+    e(GetLocal)             \
+    e(SetLocal)             \
+    e(LoadLocal)            \
+    e(GetUpvalue)           \
+    e(SetUpvalue)           \
+    e(LoadUpvalue)          \
+    e(GetCallee)            \
+    e(Closure)              \
+    e(CloseUpvalues)        \
     e(ConstructTuple)       \
+    e(ConstructMap)         \
+    e(GetIndex)             \
+    e(SetIndex)             \
+    e(DupTwo)               \
+    e(Iterate)              \
     e(TypeCmp)              \
     e(Jif)                  \
     e(Jump)                 \
     e(RollBack)             \
+    e(TableSwitch)          \
+    e(LookupSwitch)         \
     e(Call)                 \
+    e(CallNative)           \
+    e(Import)               \
+    e(Yield)                \
+    e(Resume)               \
+    e(ParallelFor)          \
     e(Return)               \
     e(NoOp)                 \
 
 
 enum class OpCode : uint8_t {FOREACH_OPCODES(GENERATE_ENUM)};
 
+// the largest constant index or operand an instruction can carry
+constexpr size_t MaxOperand = UINT16_MAX;
+
 static const char *opcode_str[] = {FOREACH_OPCODES(GENERATE_STRING)};
 
 struct Bytes
 {
     OpCode   code;
+    // index into the constant pool, or the operand itself for jumps and counts
     uint16_t constant = -1;
     uint32_t line;
 
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+#include "token.hpp"
+
+/*
+ * keyword recognition with a perfect hash built at compile time.
+ * the hash only looks at the first and last char and the length, the multiplier is searched for by the compiler
+ * until no two keywords share a slot, so a lookup is one hash and at most one comparison
+ */
+namespace keywords
+{
+    struct Keyword
+    {
+        std::string_view text;
+        TokenType type = TokenType::Identifier;
+    };
+
+    using enum TokenType;
+
+    constexpr Keyword list[] =
+    {
+        {"and",      And},
+        {"obj",      Obj},
+        {"else",     Else},
+        {"false",    False},
+        {"true",     True},
+        {"for",      For},
+        {"fn",       Fn},
+        {"if",       If},
+        {"do",       Do},
+        {"nil",      Nil},
+        {"or",       Or},
+        {"return",   Return},
+        {"super",    Super},
+        {"this",     This},
+        {"var",      Var},
+        {"const",    Const},
+        {"is",       Is},
+        {"in",       In},
+        {"while",    While},
+        {"switch",   Switch},
+        {"continue", Continue},
+        {"break",    Break},
+        {"default",  Default},
+        {"import",   Import},
+        {"yield",    Yield},
+        {"resume",   Resume},
+        {"parallel", Parallel},
+        {"into",     Into},
+    };
+
+    constexpr size_t TableSize = 128;
+
+    static_assert((TableSize & (TableSize-1)) == 0, "the table size must be a power of two");
+
+    constexpr size_t hash(std::string_view text, size_t seed)
+    {
+        return ((unsigned char)text.front() * seed + (unsigned char)text.back() + text.size()) & (TableSize-1);
+    }
+
+    constexpr size_t find_seed()
+    {
+        for(size_t seed = 1; seed < 4096; seed++)
+        {
+            std::array<bool, TableSize> used{};
+
+            bool collides = false;
+
+            for(auto &keyword : list)
+            {
+                size_t slot = hash(keyword.text, seed);
+
+                collides |= used[slot];
+                used[slot] = true;
+            }
+
+            if(!collides)
+                return seed;
+        }
+
+        return 0;
+    }
+
+    constexpr size_t Seed = find_seed();
+
+    static_assert(Seed != 0, "no perfect hash for the keyword list, grow the table");
+
+    constexpr auto table = []
+    {
+        std::array<Keyword, TableSize> table{};
+
+        for(auto &keyword : list)
+            table[hash(keyword.text, Seed)] = keyword;
+
+        return table;
+    }();
+
+    // the keyword token for text or Identifier if it is not one, text must not be empty
+    constexpr TokenType type_of(std::string_view text)
+    {
+        const Keyword &keyword = table[hash(text, Seed)];
+
+        return keyword.text == text ? keyword.type : Identifier;
+    }
+
+    static_assert(type_of("while") == While && type_of("whilst") == Identifier && type_of("in") == In);
+}
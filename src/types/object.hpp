@@ -7,12 +7,18 @@
 #include <unordered_map>
 
 #include "../util/util.hpp"
+#include "../util/memory.hpp"
 
 #define FOREACH_OBJTYPE(e)  \
          e(String)          \
          e(Function)        \
          e(NativeFunction)  \
          e(Tuple)           \
+         e(Map)             \
+         e(JumpTable)       \
+         e(Coroutine)       \
+         e(Task)            \
+         e(Channel)         \
 
 
 enum class ObjectType : uint8_t
@@ -26,6 +32,20 @@ struct Object
 {
     virtual ~Object() = default;
 
+#ifndef STRIX_NO_POOL
+    // objects are small and made and freed all the time so they come from the allocator in util/memory.hpp,
+    // deleting through an Object* passes the size of the real object since the destructor is virtual
+    static void* operator new(size_t size)
+    {
+        return memory::allocate(size);
+    }
+
+    static void operator delete(void *block, size_t size)
+    {
+        memory::release(block, size);
+    }
+#endif
+
     virtual Object* clone() = 0;
     virtual Object* move() = 0;
 
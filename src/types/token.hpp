@@ -11,6 +11,8 @@
     e(RightParen)            \
     e(LeftBrace)             \
     e(RightBrace)            \
+    e(LeftBracket)           \
+    e(RightBracket)          \
     e(Comma)                 \
     e(Dot)                   \
     e(DotDot)                \
@@ -28,6 +30,11 @@
     e(MinusMinus)            \
     e(Caret)                 \
     e(Percent)               \
+    e(Ampersand)             \
+    e(Pipe)                  \
+    e(Tilde)                 \
+    e(LessLess)              \
+    e(GreaterGreater)        \
     e(Bang)                  \
     e(BangEqual)             \
     e(Equal)                 \
@@ -41,6 +48,7 @@
     e(FStringStart)          \
     e(FStringEnd)            \
     e(Number)                \
+    e(Integer)               \
     e(And)                   \
     e(Is)                    \
     e(In)                    \
@@ -64,6 +72,11 @@
     e(Continue)              \
     e(Break)                 \
     e(Default)               \
+    e(Import)                \
+    e(Yield)                 \
+    e(Resume)                \
+    e(Parallel)              \
+    e(Into)                  \
     e(Error)                 \
     e(Eof)                   \
 
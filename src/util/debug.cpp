@@ -27,6 +27,19 @@ int jump_instruction(Chunk &chunk, int offset)
     return offset + 1;
 }
 
+int operand_instruction(Bytes &instruction, int offset)
+{
+    fmt::print("{} {}\n", opcode_str[(uint8_t)instruction.code], instruction.constant);
+    return offset + 1;
+}
+
+// the native table index and the arg count
+int native_call_instruction(Bytes &instruction, int offset)
+{
+    fmt::print("CallNative {} {}\n", instruction.constant >> 8, instruction.constant & UINT8_MAX);
+    return offset + 1;
+}
+
 int disassemble_instruction(Chunk &chunk, Bytes &instruction, int offset)
 {
     fmt::print("({}:{}) ", instruction.line, offset);
@@ -35,14 +48,35 @@ int disassemble_instruction(Chunk &chunk, Bytes &instruction, int offset)
 
     OpCode code = instruction.code;
 
-    if(code > Constant)
-        return simple_instruction(chunk, instruction, offset);
-
     switch(instruction.code)
     {
+        // these carry a raw operand rather than a constant index
+        case Jif:
+        case Jump:
+        case RollBack:
+            return jump_instruction(chunk, offset);
+        case Call:
+        case ConstructMap:
+        case SetFromTuple:
+        case GetMem:
+        case SetMem:
+        case LoadAddr:
+        case GetLocal:
+        case SetLocal:
+        case LoadLocal:
+        case GetUpvalue:
+        case SetUpvalue:
+        case LoadUpvalue:
+        case CloseUpvalues:
+            return operand_instruction(instruction, offset);
+        case CallNative:
+            return native_call_instruction(instruction, offset);
         case Constant:
             return constant_instruction(chunk.constants[instruction.constant], "Constant", offset);
         default:
+            if(code > Constant)
+                return simple_instruction(chunk, instruction, offset);
+
             std::cout << "unknown opcode found\n";
             return offset + 1;
     }
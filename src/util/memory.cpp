@@ -0,0 +1,248 @@
+#include <array>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "memory.hpp"
+
+namespace
+{
+    constexpr size_t ClassCount = memory::MaxBlock / memory::Granularity;
+
+    // blocks cut from a chunk at a time, a chunk fits 256 of the largest blocks
+    constexpr size_t ChunkSize = 64 * 1024;
+
+    // how many free blocks move between a thread and the depot at once
+    constexpr size_t BatchSize = 64;
+
+    struct Block
+    {
+        Block *next;
+    };
+
+    // a list of free blocks of one size
+    struct List
+    {
+        Block *head = nullptr;
+        size_t count = 0;
+
+        void push(Block *block)
+        {
+            block->next = head;
+            head = block;
+            count++;
+        }
+
+        Block *pop()
+        {
+            Block *block = head;
+
+            head = block->next;
+            count--;
+
+            return block;
+        }
+
+        // the first count blocks as a list of their own
+        List split(size_t count)
+        {
+            List front{head, count};
+
+            Block *last = head;
+
+            for(size_t i = 1; i < count; i++)
+                last = last->next;
+
+            head = last->next;
+            last->next = nullptr;
+
+            this->count -= count;
+
+            return front;
+        }
+    };
+
+    size_t class_of(size_t size)
+    {
+        return (size + memory::Granularity - 1) / memory::Granularity - 1;
+    }
+
+    size_t size_of(size_t size_class)
+    {
+        return (size_class + 1) * memory::Granularity;
+    }
+
+    // the space left in the chunk blocks are being cut from
+    struct Chunk
+    {
+        char *next = nullptr;
+        char *end  = nullptr;
+
+        void *cut(size_t size)
+        {
+            if(end - next < (ptrdiff_t)size)
+            {
+                next = static_cast<char*>(::operator new(ChunkSize, std::align_val_t(memory::Granularity)));
+                end  = next + ChunkSize;
+            }
+
+            return std::exchange(next, next + size);
+        }
+    };
+
+    // free blocks threads gave up, also where blocks go and come from once a thread has exited
+    struct Depot
+    {
+        std::mutex mutex;
+        std::array<std::vector<List>, ClassCount> lists;
+        Chunk chunk;
+
+        void give(size_t size_class, List list)
+        {
+            if(list.count == 0)
+                return;
+
+            std::lock_guard lock(mutex);
+
+            lists[size_class].push_back(list);
+        }
+
+        List take(size_t size_class)
+        {
+            std::lock_guard lock(mutex);
+
+            auto &free = lists[size_class];
+
+            if(free.empty())
+                return {};
+
+            List list = free.back();
+            free.pop_back();
+
+            return list;
+        }
+
+        void *allocate(size_t size_class)
+        {
+            List list = take(size_class);
+
+            if(list.count == 0)
+            {
+                std::lock_guard lock(mutex);
+
+                return chunk.cut(size_of(size_class));
+            }
+
+            void *block = list.pop();
+
+            give(size_class, list);
+
+            return block;
+        }
+
+        void release(void *block, size_t size_class)
+        {
+            List list;
+
+            list.push(static_cast<Block*>(block));
+
+            give(size_class, list);
+        }
+    };
+
+    // never destroyed since objects in statics can be freed after every other static is gone
+    Depot &depot()
+    {
+        static Depot *depot = new Depot;
+        return *depot;
+    }
+
+    struct Cache
+    {
+        std::array<List, ClassCount> lists;
+        Chunk chunk;
+
+        ~Cache()
+        {
+            for(size_t i = 0; i < ClassCount; i++)
+                depot().give(i, lists[i]);
+        }
+
+        void *allocate(size_t size_class)
+        {
+            List &list = lists[size_class];
+
+            if(list.count == 0)
+                list = depot().take(size_class);
+
+            if(list.count > 0)
+                return list.pop();
+
+            return chunk.cut(size_of(size_class));
+        }
+
+        void release(void *block, size_t size_class)
+        {
+            List &list = lists[size_class];
+
+            list.push(static_cast<Block*>(block));
+
+            // a thread that frees what others allocate, like the receiving end of a channel, passes blocks on
+            if(list.count >= BatchSize * 2)
+                depot().give(size_class, list.split(BatchSize));
+        }
+    };
+
+    // set while the thread has a cache, the cache itself is made on first use and destroyed when the thread exits
+    thread_local Cache *t_cache = nullptr;
+    thread_local bool t_exited = false;
+
+    struct CacheOwner
+    {
+        Cache cache;
+
+        ~CacheOwner()
+        {
+            t_cache  = nullptr;
+            t_exited = true;
+        }
+    };
+
+    // nullptr once the thread is exiting, objects freed by thread_local destructors after that go to the depot
+    Cache *cache()
+    {
+        if(t_cache || t_exited)
+            return t_cache;
+
+        thread_local CacheOwner owner;
+
+        return t_cache = &owner.cache;
+    }
+}
+
+void *memory::allocate(size_t size)
+{
+    if(size > MaxBlock)
+        return ::operator new(size);
+
+    size_t size_class = class_of(size);
+
+    if(Cache *cache = ::cache())
+        return cache->allocate(size_class);
+
+    return depot().allocate(size_class);
+}
+
+void memory::release(void *block, size_t size)
+{
+    if(size > MaxBlock)
+        return ::operator delete(block);
+
+    size_t size_class = class_of(size);
+
+    if(Cache *cache = ::cache())
+        return cache->release(block, size_class);
+
+    depot().release(block, size_class);
+}
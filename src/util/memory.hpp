@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+
+/*
+ * the allocator objects are made with. small blocks are handed out from free lists per size class that every
+ * thread keeps for itself, so a vm allocating and freeing strings and tuples never takes a lock, and new blocks
+ * are cut from large chunks one after another so objects made together sit together.
+ *
+ * objects move between vms through channels and tasks so a block can be freed on another thread than the one it
+ * came from, it simply joins that threads free list. a thread with more free blocks of a size than it is likely
+ * to need, or one that exits, hands them to a shared depot the other threads refill from. chunks are never given
+ * back to the system.
+ *
+ * define STRIX_NO_POOL to allocate every object with plain new, for sanitizer builds
+ */
+namespace memory
+{
+    // blocks are multiples of this and aligned to it
+    constexpr size_t Granularity = 16;
+
+    // anything larger is left to operator new
+    constexpr size_t MaxBlock = 256;
+
+    void* allocate(size_t size);
+
+    // size must be what the block was allocated with
+    void release(void *block, size_t size);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+#if defined(__SSE2__) && !defined(STRIX_NO_SIMD)
+#define STRIX_SSE2 1
+#include <emmintrin.h>
+#else
+#define STRIX_SSE2 0
+#endif
+
+/*
+ * the scanners hot loops, each returns the offset of the first char at or after from that ends the run or text.size().
+ * with sse2 (every x86-64 cpu has it) 16 chars are classified per step and the tail is finished a char at a time,
+ * define STRIX_NO_SIMD to only use the scalar loops
+ */
+namespace simd
+{
+    inline bool is_identifier(char c)
+    {
+        return (c >= 'a' && c <= 'z') ||
+               (c >= 'A' && c <= 'Z') ||
+               (c >= '0' && c <= '9') ||
+               c == '_';
+    }
+
+    inline bool is_blank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+#if STRIX_SSE2
+    // a bit per char, set where the chunk holds a char of the class
+    inline unsigned identifier_mask(__m128i chunk)
+    {
+        // sse2 only compares signed bytes so ranges are shifted to start at -128 before comparing,
+        // or-ing in 0x20 folds upper case onto lower case
+        __m128i lower  = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        __m128i letter = _mm_cmplt_epi8(_mm_add_epi8(lower, _mm_set1_epi8(char(128 - 'a'))), _mm_set1_epi8(-128 + 26));
+        __m128i digit  = _mm_cmplt_epi8(_mm_add_epi8(chunk, _mm_set1_epi8(char(128 - '0'))), _mm_set1_epi8(-128 + 10));
+        __m128i under  = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+
+        return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), under));
+    }
+
+    inline unsigned blank_mask(__m128i chunk)
+    {
+        __m128i space = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+        __m128i tab   = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'));
+        __m128i cr    = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'));
+
+        return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(space, tab), cr));
+    }
+
+    inline __m128i load(std::string_view text, size_t offset)
+    {
+        return _mm_loadu_si128((const __m128i*)(text.data() + offset));
+    }
+#endif
+
+    // end of an identifier or keyword
+    inline size_t skip_identifier(std::string_view text, size_t from)
+    {
+#if STRIX_SSE2
+        for(; from + 16 <= text.size(); from += 16)
+        {
+            unsigned stop = ~identifier_mask(load(text, from)) & 0xFFFF;
+
+            if(stop)
+                return from + __builtin_ctz(stop);
+        }
+#endif
+        while(from < text.size() && is_identifier(text[from]))
+            from++;
+
+        return from;
+    }
+
+    // end of a run of spaces, tabs and carriage returns
+    inline size_t skip_blanks(std::string_view text, size_t from)
+    {
+#if STRIX_SSE2
+        for(; from + 16 <= text.size(); from += 16)
+        {
+            unsigned stop = ~blank_mask(load(text, from)) & 0xFFFF;
+
+            if(stop)
+                return from + __builtin_ctz(stop);
+        }
+#endif
+        while(from < text.size() && is_blank(text[from]))
+            from++;
+
+        return from;
+    }
+
+    // the next a or b, like the closing quote or newline of a string
+    inline size_t find_either(std::string_view text, size_t from, char a, char b)
+    {
+#if STRIX_SSE2
+        __m128i first  = _mm_set1_epi8(a);
+        __m128i second = _mm_set1_epi8(b);
+
+        for(; from + 16 <= text.size(); from += 16)
+        {
+            __m128i chunk = load(text, from);
+
+            unsigned found = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, first), _mm_cmpeq_epi8(chunk, second)));
+
+            if(found)
+                return from + __builtin_ctz(found);
+        }
+#endif
+        while(from < text.size() && text[from] != a && text[from] != b)
+            from++;
+
+        return from;
+    }
+}
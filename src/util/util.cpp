@@ -1,37 +1,142 @@
 #include "util.hpp"
 
-#include <iostream>
+#include <algorithm>
+#include <cerrno>
 #include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAP_SOURCE
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#endif
 
-inline size_t file_size(const char *filename)
+SourceFile::SourceFile(SourceFile &&file) noexcept
 {
-    struct stat st;
+    *this = std::move(file);
+}
+
+SourceFile& SourceFile::operator=(SourceFile &&file) noexcept
+{
+    if(this == &file)
+        return *this;
+
+    unmap();
 
-    stat(filename, &st);
+    m_mapped = file.m_mapped;
+    m_buffer = std::move(file.m_buffer);
+    m_size   = file.m_size;
+    // the buffers data pointer moves along with the buffer
+    m_data   = m_mapped ? file.m_data : m_buffer.data();
+
+    file.m_data   = nullptr;
+    file.m_size   = 0;
+    file.m_mapped = false;
+
+    return *this;
+}
+
+SourceFile::~SourceFile()
+{
+    unmap();
+}
 
-    return st.st_size;
+void SourceFile::unmap()
+{
+#ifdef MAP_SOURCE
+    if(m_mapped)
+        munmap((void*)m_data, m_size);
+#endif
+    m_mapped = false;
 }
 
-std::optional<std::string> read_file(std::filesystem::path &&path)
+std::optional<SourceFile> read_file(std::filesystem::path &&path)
 {
-    std::fstream file(path, std::fstream::in);
+    SourceFile file;
+
+#ifdef MAP_SOURCE
+    int fd = open(path.c_str(), O_RDONLY);
 
-    if(!file.is_open())
+    if(fd == -1)
         return std::nullopt;
 
-    std::string output;
+    struct stat st;
+
+    if(fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return std::nullopt;
+    }
+
+    // pipes, fifos and /dev/fd/* report a size of 0 and cannot be mapped, they are read until they end
+    bool regular = S_ISREG(st.st_mode);
+    size_t size  = regular ? st.st_size : 0;
+
+    // empty files cannot be mapped and there is nothing to read anyway
+    if(size > 0)
+    {
+        void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(data != MAP_FAILED)
+        {
+            // the scanner walks the source front to back
+            madvise(data, size, MADV_SEQUENTIAL);
+
+            file.m_data   = (const char*)data;
+            file.m_size   = size;
+            file.m_mapped = true;
+        }
+    }
+
+    if(!file.m_mapped && (size > 0 || !regular))
+    {
+        // falls back to reading the whole file with as few calls as possible
+        file.m_buffer.resize(std::max<size_t>(size, 4096));
+
+        size_t offset = 0;
+
+        while(true)
+        {
+            if(offset == file.m_buffer.size())
+                file.m_buffer.resize(offset * 2);
+
+            ssize_t count = read(fd, file.m_buffer.data() + offset, file.m_buffer.size() - offset);
 
-    size_t f_size = file_size(path.string().data());
+            if(count == -1 && errno == EINTR)
+                continue;
 
-    output.reserve(f_size);
+            if(count <= 0)
+                break;
+
+            offset += count;
+        }
 
-    char c;
+        file.m_buffer.resize(offset);
+    }
+
+    close(fd);
+#else
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
 
-    while((c = file.get()) != EOF)
-        output += c;
+    if(!stream.is_open())
+        return std::nullopt;
+
+    stream.seekg(0, std::ios::end);
+    file.m_buffer.resize(stream.tellg());
+    stream.seekg(0, std::ios::beg);
+
+    stream.read(file.m_buffer.data(), file.m_buffer.size());
+    file.m_buffer.resize(stream.gcount());
+#endif
+
+    if(!file.m_mapped)
+    {
+        file.m_data = file.m_buffer.data();
+        file.m_size = file.m_buffer.size();
+    }
 
-    return output;
+    return file;
 }
 
 std::string number_str(double value)
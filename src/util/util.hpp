@@ -12,8 +12,51 @@
 #include <optional>
 #include <filesystem>
 #include <concepts>
+#include <limits>
+#include <string_view>
 
-std::optional<std::string> read_file(std::filesystem::path &&path);
+/*
+ * the contents of a source file, memory mapped when the platform allows it and read in one go otherwise
+ * identifiers and string constants are views into the source so it must outlive whatever is compiled from it
+ */
+class SourceFile
+{
+public:
+    SourceFile() = default;
+
+    SourceFile(SourceFile &&file) noexcept;
+
+    SourceFile& operator=(SourceFile &&file) noexcept;
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    ~SourceFile();
+
+    std::string_view view() const
+    {
+        return {m_data, m_size};
+    }
+
+    operator std::string_view() const
+    {
+        return view();
+    }
+
+private:
+    friend std::optional<SourceFile> read_file(std::filesystem::path &&path);
+
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    bool m_mapped = false;
+
+    // holds the contents when the file could not be mapped
+    std::string m_buffer;
+
+    void unmap();
+};
+
+std::optional<SourceFile> read_file(std::filesystem::path &&path);
 
 /*
  * converts a double to a precise string representation removing trailing zeros
@@ -31,5 +74,62 @@ inline T max_of(T t)
 template<std::integral T>
 inline T min_of(T t)
 {
-    return std::numeric_limits<T>::minx();
+    return std::numeric_limits<T>::min();
+}
+
+// checked integer arithmetic, returns true if the result overflowed
+template<std::integral T>
+inline bool add_overflow(T a, T b, T *result)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_add_overflow(a, b, result);
+#else
+    if((b > 0 && a > max_of(a) - b) || (b < 0 && a < std::numeric_limits<T>::min() - b))
+        return true;
+    *result = a + b;
+    return false;
+#endif
+}
+
+template<std::integral T>
+inline bool sub_overflow(T a, T b, T *result)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_sub_overflow(a, b, result);
+#else
+    if((b < 0 && a > max_of(a) + b) || (b > 0 && a < std::numeric_limits<T>::min() + b))
+        return true;
+    *result = a - b;
+    return false;
+#endif
+}
+
+template<std::integral T>
+inline bool mul_overflow(T a, T b, T *result)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_mul_overflow(a, b, result);
+#else
+    if(a != 0 && b != 0)
+    {
+        T max = max_of(a), min = std::numeric_limits<T>::min();
+
+        if((a == -1 && b == min) || (b == -1 && a == min))
+            return true;
+        if(a > 0 ? (b > 0 ? a > max / b : b < min / a) : (b > 0 ? a < min / b : a < max / b))
+            return true;
+    }
+    *result = a * b;
+    return false;
+#endif
+}
+
+// logical shift that accepts any shift amount, negative amounts shift the other way
+// and shifting by 64 or more clears every bit
+inline int64_t shift_left(int64_t value, int64_t amount)
+{
+    if(amount <= -64 || amount >= 64)
+        return 0;
+
+    return amount >= 0 ? (int64_t)((uint64_t)value << amount) : (int64_t)((uint64_t)value >> -amount);
 }
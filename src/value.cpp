@@ -25,8 +25,17 @@ void Value::copy_from(const Value &value)
         as = value.as;
 }
 
+// true if both operands are numbers but only one of them is an int, in which case the int is promoted
+static inline bool mixed_numbers(const Value &a, const Value &b)
+{
+    return a.type != b.type && a.is_number() && b.is_number();
+}
+
 bool operator==(const Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b))
+        return a.as_double() == b.as_double();
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -35,6 +44,7 @@ bool operator==(const Value &a, const Value &b)
         case ValueType::Nil:    return true;
         case ValueType::Bool:   return a.as.boolean == b.as.boolean;
         case ValueType::Number: return a.as.number  == b.as.number;
+        case ValueType::Int:    return a.as.integer == b.as.integer;
         case ValueType::Object: return a.as.object->compare(b.as.object);
         default: return false;
     }
@@ -42,6 +52,9 @@ bool operator==(const Value &a, const Value &b)
 
 Value operator+(const Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b))
+        return Value(a.as_double() + b.as_double());
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -50,6 +63,15 @@ Value operator+(const Value &a, const Value &b)
         case ValueType::Nil:    return nullptr;
         case ValueType::Bool:   return Value((double)a.as.boolean + b.as.boolean);
         case ValueType::Number: return Value(a.as.number + b.as.number);
+        case ValueType::Int:
+        {
+            int64_t result;
+
+            if(add_overflow(a.as.integer, b.as.integer, &result))
+                return Value(a.as_double() + b.as_double());
+
+            return Value(result);
+        }
         case ValueType::Object: return a.as.object->add(b.as.object);
         default: return nullptr;
     }
@@ -62,16 +84,54 @@ std::string Value::to_string() const
     switch(type)
     {
         case Number:  return number_str(as.number);
+        case Int:     return std::to_string(as.integer);
         case Bool:    return as.boolean ? "true" : "false";
         case Nil:     return "nil";
         case Object:  return as.object->to_string();
-        case Address: return std::to_string(as.address);
+        case Address: return as.address->to_string();
         default:      return "unknown type";
     }
 }
 
+bool Value::as_index(size_t &index) const
+{
+    if(type == ValueType::Int && as.integer >= 0)
+    {
+        index = as.integer;
+        return true;
+    }
+
+    if(type == ValueType::Number && as.number >= 0 && (double)(size_t)as.number == as.number)
+    {
+        index = as.number;
+        return true;
+    }
+
+    return false;
+}
+
+bool Value::as_integer(int64_t &integer) const
+{
+    if(type == ValueType::Int)
+    {
+        integer = as.integer;
+        return true;
+    }
+
+    if(type == ValueType::Number && as.number >= -0x1p63 && as.number < 0x1p63 && std::floor(as.number) == as.number)
+    {
+        integer = as.number;
+        return true;
+    }
+
+    return false;
+}
+
 Value operator-(const Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b))
+        return Value(a.as_double() - b.as_double());
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -80,6 +140,15 @@ Value operator-(const Value &a, const Value &b)
         case ValueType::Nil:    return nullptr;
         case ValueType::Bool:   return Value((double)a.as.boolean - b.as.boolean);
         case ValueType::Number: return Value(a.as.number - b.as.number);
+        case ValueType::Int:
+        {
+            int64_t result;
+
+            if(sub_overflow(a.as.integer, b.as.integer, &result))
+                return Value(a.as_double() - b.as_double());
+
+            return Value(result);
+        }
         case ValueType::Object: return a.as.object->subtract(b.as.object);
         default: return nullptr;
     }
@@ -87,6 +156,9 @@ Value operator-(const Value &a, const Value &b)
 
 Value &operator+=(Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b) || a.type == ValueType::Int)
+        return a = a + b;
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -100,32 +172,49 @@ Value &operator+=(Value &a, const Value &b)
     return a;
 }
 
+// division always produces a double, ints only stay ints while the result is exact
 Value operator/(const Value &a, const Value &b)
 {
-    if(a.type != b.type)
+    if(a.type != b.type && !mixed_numbers(a, b))
         throw std::runtime_error("invalid operands to binary expression");
 
     switch(a.type)
     {
-        case ValueType::Number: return Value(a.as.number / b.as.number);
+        case ValueType::Number:
+        case ValueType::Int: return Value(a.as_double() / b.as_double());
         default: return nullptr;
     }
 }
 
 Value operator*(const Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b))
+        return Value(a.as_double() * b.as_double());
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
     switch(a.type)
     {
         case ValueType::Number: return Value(a.as.number * b.as.number);
+        case ValueType::Int:
+        {
+            int64_t result;
+
+            if(mul_overflow(a.as.integer, b.as.integer, &result))
+                return Value(a.as_double() * b.as_double());
+
+            return Value(result);
+        }
         default: return nullptr;
     }
 }
 
 bool operator>(const Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b))
+        return a.as_double() > b.as_double();
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -134,12 +223,16 @@ bool operator>(const Value &a, const Value &b)
         case ValueType::Nil:    return false;
         case ValueType::Bool:   return a.as.boolean > b.as.boolean;
         case ValueType::Number: return a.as.number > b.as.number;
+        case ValueType::Int:    return a.as.integer > b.as.integer;
         default: return false;
     }
 }
 
 bool operator<(const Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b))
+        return a.as_double() < b.as_double();
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -148,12 +241,16 @@ bool operator<(const Value &a, const Value &b)
         case ValueType::Nil:    return false;
         case ValueType::Bool:   return a.as.boolean < b.as.boolean;
         case ValueType::Number: return a.as.number < b.as.number;
+        case ValueType::Int:    return a.as.integer < b.as.integer;
         default: return false;
     }
 }
 
 Value &operator-=(Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b) || a.type == ValueType::Int)
+        return a = a - b;
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -168,6 +265,9 @@ Value &operator-=(Value &a, const Value &b)
 
 Value &operator*=(Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b) || a.type == ValueType::Int)
+        return a = a * b;
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -182,6 +282,9 @@ Value &operator*=(Value &a, const Value &b)
 
 Value &operator/=(Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b) || a.type == ValueType::Int)
+        return a = a / b;
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -196,6 +299,9 @@ Value &operator/=(Value &a, const Value &b)
 
 bool operator<=(const Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b))
+        return a.as_double() <= b.as_double();
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -203,12 +309,16 @@ bool operator<=(const Value &a, const Value &b)
     {
         case ValueType::Nil:    return false;
         case ValueType::Number: return a.as.number <= b.as.number;
+        case ValueType::Int:    return a.as.integer <= b.as.integer;
         default: return false;
     }
 }
 
 bool operator>=(const Value &a, const Value &b)
 {
+    if(mixed_numbers(a, b))
+        return a.as_double() >= b.as_double();
+
     if(a.type != b.type)
         throw std::runtime_error("invalid operands to binary expression");
 
@@ -216,32 +326,54 @@ bool operator>=(const Value &a, const Value &b)
     {
         case ValueType::Nil:    return false;
         case ValueType::Number: return a.as.number >= b.as.number;
+        case ValueType::Int:    return a.as.integer >= b.as.integer;
         default: return false;
     }
 }
 
 Value Value::power(const Value &b) const
 {
-    if(type != b.type)
+    if(!is_number() || !b.is_number())
         throw std::runtime_error("invalid operands to binary expression");
 
-    switch(type)
+    // exponentiation by squaring keeps exact results for ints until they overflow
+    if(type == ValueType::Int && b.type == ValueType::Int && b.as.integer >= 0)
     {
-        case ValueType::Number: return Value(std::pow(as.number, b.as.number));
-        default: return nullptr;
+        int64_t base = as.integer, exponent = b.as.integer, result = 1;
+
+        while(true)
+        {
+            if((exponent & 1) && mul_overflow(result, base, &result))
+                break;
+
+            exponent >>= 1;
+
+            if(exponent == 0)
+                return Value(result);
+
+            if(mul_overflow(base, base, &base))
+                break;
+        }
     }
+
+    return Value(std::pow(as_double(), b.as_double()));
 }
 
 Value Value::mod(const Value &b) const
 {
-    if(type != b.type)
+    if(!is_number() || !b.is_number())
         throw std::runtime_error("invalid operands to binary expression");
 
-    switch(type)
+    if(type == ValueType::Int && b.type == ValueType::Int)
     {
-        case ValueType::Number: return Value(std::fmod(as.number, b.as.number));
-        default: return nullptr;
+        if(b.as.integer == 0)
+            throw std::runtime_error("integer modulo by zero");
+
+        // INT64_MIN % -1 overflows in hardware even though the result is 0
+        return Value(b.as.integer == -1 ? int64_t{0} : as.integer % b.as.integer);
     }
+
+    return Value(std::fmod(as_double(), b.as_double()));
 }
 
 bool Value::is_falsy() const
@@ -254,22 +386,12 @@ bool Value::is_falsy() const
 
 bool Value::type_cmp(const Value &b) const
 {
-    return type == b.type;
+    return type == b.type || (is_number() && b.is_number());
 }
 
 bool operator!=(const Value &a, const Value &b)
 {
-    if(a.type != b.type)
-        throw std::runtime_error("invalid operands to binary expression");
-
-    switch(a.type)
-    {
-        case ValueType::Nil:    return true;
-        case ValueType::Bool:   return a.as.boolean != b.as.boolean;
-        case ValueType::Number: return a.as.number  != b.as.number;
-        case ValueType::Object: return !a.as.object->compare(b.as.object);
-        default: return false;
-    }
+    return !(a == b);
 }
 
 
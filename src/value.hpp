@@ -9,7 +9,7 @@
 
 enum class ValueType : uint8_t
 {
-    Number, Bool, Nil, Object, Address
+    Number, Int, Bool, Nil, Object, Address
 };
 
 // can reduce struct size by 8 bytes
@@ -23,10 +23,11 @@ struct Value
     union
     {
         double number;
+        int64_t integer;
         bool boolean;
         std::nullptr_t nil;
         Object *object;
-        uint16_t address; // address for the vms memory
+        Value *address; // address of a slot in the vms memory, used to assign through a variable
     } as{};
 
     Value() :
@@ -39,7 +40,12 @@ struct Value
         as{.number = value}
     {}
 
-    explicit Value(uint16_t value) :
+    explicit Value(int64_t value) :
+        type(ValueType::Int),
+        as{.integer = value}
+    {}
+
+    explicit Value(Value *value) :
         type(ValueType::Address),
         as{.address = value}
     {}
@@ -71,10 +77,7 @@ struct Value
 
     ~Value()
     {
-        if(type == ValueType::Object)
-        {
-            delete as.object;
-        }
+        release();
     }
 
     template<typename T>
@@ -86,13 +89,21 @@ struct Value
 
     Value& operator=(Value &&value) noexcept
     {
-        move_from(std::forward<Value>(value));
+        if(this != &value)
+        {
+            release();
+            move_from(std::forward<Value>(value));
+        }
         return *this;
     }
 
     Value& operator=(const Value &value)
     {
-        copy_from(value);
+        if(this != &value)
+        {
+            release();
+            copy_from(value);
+        }
         return *this;
     }
 
@@ -106,6 +117,23 @@ struct Value
 
     std::string to_string() const;
 
+    // ints and doubles are both numbers to scripts, mixing them promotes the int
+    inline bool is_number() const
+    {
+        return type == ValueType::Number || type == ValueType::Int;
+    }
+
+    inline double as_double() const
+    {
+        return type == ValueType::Int ? (double)as.integer : as.number;
+    }
+
+    // writes the value as an index if it is a non negative integral number
+    bool as_index(size_t &index) const;
+
+    // writes the value as an int if it is an integral number in range
+    bool as_integer(int64_t &integer) const;
+
 
     friend Value operator+(const Value &a, const Value &b);
 
@@ -148,6 +176,13 @@ private:
     void move_from(Value &&value);
     void copy_from(const Value &value);
 
+    // frees the owned object so the value can be overwritten without leaking it
+    inline void release()
+    {
+        if(type == ValueType::Object)
+            delete as.object;
+    }
+
 };
 
 #pragma pack(pop)
\ No newline at end of file
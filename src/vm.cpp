@@ -6,11 +6,16 @@
 #include "vm.hpp"
 #include "types/chunk.hpp"
 #include "compiler.hpp"
+#include "module.hpp"
 #include "util/fmt.hpp"
 #include "util/debug.hpp"
 #include "objects/string.hpp"
+#include "objects/coroutine.hpp"
 #include "value.hpp"
 #include "objects/tuple.hpp"
+#include "objects/map.hpp"
+#include "objects/jump_table.hpp"
+#include "scheduler.hpp"
 
 #define BINARY_OP(op)               \
     do                              \
@@ -30,8 +35,7 @@
 #define BINARY_OP_MOD(op) \
     do                              \
     {                     \
-          uint16_t addr = pop().as.address; \
-          Value &mem = m_data[addr];           \
+          Value &mem = *pop().as.address;  \
           Value value = pop();              \
           try             \
           {               \
@@ -43,6 +47,48 @@
     } while(false)
 
 
+// fast path for two int operands, overflowing results are promoted to doubles
+#define INT_BINARY_OP(overflow_fn, op)                           \
+    if(same_operands(ValueType::Int))                            \
+    {                                                            \
+        int64_t b = m_stack.back().as.integer;                   \
+        m_stack.pop_back();                                      \
+        Value &a = m_stack.back();                               \
+        int64_t result;                                          \
+                                                                 \
+        if(overflow_fn(a.as.integer, b, &result))                \
+            a = Value((double)a.as.integer op (double)b);        \
+        else                                                     \
+            a.as.integer = result;                               \
+        break;                                                   \
+    }
+
+#define INT_COMPARE_OP(op)                                       \
+    if(same_operands(ValueType::Int))                            \
+    {                                                            \
+        int64_t b = m_stack.back().as.integer;                   \
+        m_stack.pop_back();                                      \
+        Value &a = m_stack.back();                               \
+        a = Value(a.as.integer op b);                            \
+        break;                                                   \
+    }
+
+// bitwise operators work on ints and on doubles that hold an integral value
+#define BITWISE_OP(expr)                                                      \
+    {                                                                         \
+        int64_t a, b;                                                         \
+                                                                              \
+        if(!integer_operands(a, b))                                           \
+        {                                                                     \
+            runtime_error("operands to bitwise expression must be integers"); \
+            break;                                                            \
+        }                                                                     \
+                                                                              \
+        m_stack.pop_back();                                                   \
+        m_stack.back() = Value((int64_t)(expr));                              \
+        break;                                                                \
+    }
+
 InterpretResult VM::interpret(std::string_view source)
 {
     Compiler compiler(source);
@@ -52,18 +98,96 @@ InterpretResult VM::interpret(std::string_view source)
     if(!result.has_value())
         return InterpretResult::CompileError;
 
+    return interpret(std::move(result.value()));
+}
+
+InterpretResult VM::interpret(Function &&program)
+{
     CallFrame &frame = m_frames[m_frame_cursor];
 
-    frame.function = std::move(result.value());
+    frame.function = std::move(program);
+    frame.base     = m_data.data();
+    frame.globals  = m_data.data();
+    frame.pc       = 0;
+
+    m_data_top = m_data.data() + frame.function.slot_count;
+    m_data_end = m_data.data() + m_data.size();
+    m_fiber.reset();
+
+    m_global_count = frame.function.slot_count;
+
+    return run();
+}
+
+InterpretResult VM::interpret(const Function &program)
+{
+    return interpret(Function(program));
+}
+
+InterpretResult VM::interpret(Function &&program, std::vector<Value> &&globals)
+{
+    if(globals.size() > program.slot_count)
+        return InterpretResult::RuntimeError;
+
+    std::move(globals.begin(), globals.end(), m_data.begin());
+
+    return interpret(std::move(program));
+}
+
+InterpretResult VM::invoke(Function &&function, std::vector<Value> &&args, std::vector<Value> &&globals)
+{
+    // the vm may have run something before, a failed run can leave values anywhere.
+    // nil is spelled out since a bare nullptr would convert to a Value holding a null object
+    if(m_state != InterpretResult::Ok)
+        m_data.fill(Value(nullptr));
+    else if(m_data_top)
+        std::fill(m_data.data(), m_data_top, Value(nullptr));
+
+    m_stack.clear();
+    m_open_upvalues.clear();
+    m_fiber.reset();
+
+    m_state        = InterpretResult::Ok;
+    m_frame_cursor = 0;
+
+    if(function.lazy && !Compiler::compile_lazy(function))
+        return m_state = InterpretResult::CompileError;
+
+    if(globals.size() + function.slot_count > m_data.size())
+        return m_state = InterpretResult::RuntimeError;
+
+    std::move(globals.begin(), globals.end(), m_data.begin());
+
+    m_global_count = globals.size();
+
+    CallFrame &frame = m_frames[0];
+
+    frame.function = std::move(function);
+    frame.base     = m_data.data() + m_global_count;
+    frame.globals  = m_data.data();
+    frame.pc       = 0;
+
+    m_data_top = frame.base + frame.function.slot_count;
+    m_data_end = m_data.data() + m_data.size();
+
+    for(auto &arg : args)
+        m_stack.push_back(std::move(arg));
+
+    set_fn_params(frame.function.param_count, args.size());
 
     return run();
 }
 
+std::vector<Value> VM::globals() const
+{
+    return {m_data.begin(), m_data.begin() + m_global_count};
+}
+
 InterpretResult VM::run()
 {
     using enum OpCode;
 
-#define CHUNK m_frames[m_frame_cursor].function.chunk
+#define CHUNK (*m_frames[m_frame_cursor].function.chunk)
 
 #if DEBUG_TRACE
     fmt::print("instructions\n{}\n", CHUNK.bytes);
@@ -71,15 +195,17 @@ InterpretResult VM::run()
 
     CallFrame *frame  = &m_frames[m_frame_cursor];
     size_t pc = frame->pc;
+    // the running functions chunk, kept in a local so fetching an instruction does not go through the shared pointer
+    const Chunk *chunk = frame->function.chunk.get();
 
     while(true)
     {
         if(m_state != InterpretResult::Ok)
             return m_state;
 
-        Bytes instruction = frame->function.chunk.bytes[pc++];
+        Bytes instruction = chunk->bytes[pc++];
 
-#define CONSTANT frame->function.chunk.constants[instruction.constant]
+#define CONSTANT chunk->constants[instruction.constant]
 
 #if DEBUG_TRACE
         disassemble_instruction(CHUNK, instruction, pc);
@@ -94,6 +220,8 @@ InterpretResult VM::run()
 
             case Add:
             {
+                INT_BINARY_OP(add_overflow, +)
+
                 if(match(ValueType::Address))
                     BINARY_OP_MOD(+=);
                 else
@@ -102,6 +230,8 @@ InterpretResult VM::run()
             }
             case Subtract:
             {
+                INT_BINARY_OP(sub_overflow, -)
+
                 if(match(ValueType::Address))
                     BINARY_OP_MOD(-=);
                 else
@@ -110,6 +240,8 @@ InterpretResult VM::run()
             }
             case Multiply:
             {
+                INT_BINARY_OP(mul_overflow, *)
+
                 if(match(ValueType::Address))
                     BINARY_OP_MOD(*=);
                 else
@@ -124,28 +256,52 @@ InterpretResult VM::run()
                     BINARY_OP(/);
                 break;
             }
-            case Greater:  BINARY_OP(>); break;
-            case Less:     BINARY_OP(<); break;
+            case Greater:
+            {
+                INT_COMPARE_OP(>)
+                BINARY_OP(>);
+                break;
+            }
+            case Less:
+            {
+                INT_COMPARE_OP(<)
+                BINARY_OP(<);
+                break;
+            }
 
             case Mod:
             {
-                if(!same_operands(ValueType::Number))
+                if(same_operands(ValueType::Int) && m_stack.back().as.integer > 0)
+                {
+                    int64_t b = m_stack.back().as.integer;
+                    m_stack.pop_back();
+                    m_stack.back().as.integer %= b;
+                    break;
+                }
+
+                if(!numeric_operands())
                 {
                     runtime_error("operands to binary expression must be numbers");
                     break;
                 }
 
-                Value b = pop();
-                Value a = pop();
+                try
+                {
+                    Value b = pop();
+                    Value a = pop();
 
-                m_stack.emplace_back(std::fmod(a.as.number, b.as.number));
+                    m_stack.push_back(a.mod(b));
+                } catch(std::exception &e)
+                {
+                    runtime_error(e.what());
+                }
 
                 break;
             }
 
             case Power:
             {
-                if(!same_operands(ValueType::Number))
+                if(!numeric_operands())
                 {
                     runtime_error("operands to binary expression must be numbers");
                     break;
@@ -154,8 +310,28 @@ InterpretResult VM::run()
                 Value b = pop();
                 Value a = pop();
 
-                m_stack.emplace_back(std::pow(a.as.number, b.as.number));
+                m_stack.push_back(a.power(b));
+
+                break;
+            }
+
+            case BitAnd:     BITWISE_OP(a & b)
+            case BitOr:      BITWISE_OP(a | b)
+            case BitXor:     BITWISE_OP(a ^ b)
+            case ShiftLeft:  BITWISE_OP(shift_left(a, b))
+            case ShiftRight: BITWISE_OP(shift_left(a, b == min_of(b) ? 64 : -b))
+
+            case BitNot:
+            {
+                int64_t value;
+
+                if(!m_stack.back().as_integer(value))
+                {
+                    runtime_error("operand to bitwise expression must be an integer");
+                    break;
+                }
 
+                m_stack.back() = Value(~value);
                 break;
             }
 
@@ -167,6 +343,8 @@ InterpretResult VM::run()
 
             case Cmp:
             {
+                INT_COMPARE_OP(==)
+
                 Value b = pop();
                 Value a = pop();
 
@@ -179,27 +357,48 @@ InterpretResult VM::run()
 
             case Negate:
             {
-                if(m_stack.back().type != ValueType::Number)
+                Value &value = m_stack.back();
+
+                if(!value.is_number())
                 {
                     runtime_error("negation operand must be a number");
                     return InterpretResult::RuntimeError;
                 }
 
-                m_stack.back().as.number = -m_stack.back().as.number;
+                if(value.type == ValueType::Number)
+                    value.as.number = -value.as.number;
+                else if(value.as.integer != min_of(value.as.integer))
+                    value.as.integer = -value.as.integer;
+                else
+                    value = Value(-(double)value.as.integer);
 
                 break;
             }
 
             case Increment:
             {
-                Value &value = m_data[pop().as.address];
-                value.as.number++;
+                Value &value = *pop().as.address;
+
+                if(value.type != ValueType::Int)
+                    value.as.number++;
+                else if(value.as.integer != max_of(value.as.integer))
+                    value.as.integer++;
+                else
+                    value = Value((double)value.as.integer + 1);
+
                 break;
             }
             case Decrement:
             {
-                Value &value = m_data[pop().as.address];
-                value.as.number--;
+                Value &value = *pop().as.address;
+
+                if(value.type != ValueType::Int)
+                    value.as.number--;
+                else if(value.as.integer != min_of(value.as.integer))
+                    value.as.integer--;
+                else
+                    value = Value((double)value.as.integer - 1);
+
                 break;
             }
 
@@ -230,33 +429,91 @@ InterpretResult VM::run()
                 break;
             }
 
+            // slot indexes are stored directly in the instruction
             case SetMem:
             {
-                Value value = pop();
-                uint16_t index = CONSTANT.as.address;
-
-                m_data[index] = std::move(value);
-
+                frame->globals[instruction.constant] = pop();
                 break;
             }
             case GetMem:
             {
-                uint16_t index = CONSTANT.as.address;
-
-                Value &value = m_data[index];
+                m_stack.push_back(frame->globals[instruction.constant]);
+                break;
+            }
+            case LoadAddr:
+            {
+                m_stack.emplace_back(&frame->globals[instruction.constant]);
+                break;
+            }
 
-                m_stack.push_back(value);
+            case SetLocal:
+            {
+                frame->base[instruction.constant] = pop();
+                break;
+            }
+            case GetLocal:
+            {
+                m_stack.push_back(frame->base[instruction.constant]);
+                break;
+            }
+            case LoadLocal:
+            {
+                m_stack.emplace_back(&frame->base[instruction.constant]);
+                break;
+            }
 
+            case SetUpvalue:
+            {
+                *frame->function.upvalues[instruction.constant]->location = pop();
                 break;
             }
-            case LoadAddr:
+            case GetUpvalue:
+            {
+                m_stack.push_back(*frame->function.upvalues[instruction.constant]->location);
+                break;
+            }
+            case LoadUpvalue:
+            {
+                m_stack.emplace_back(frame->function.upvalues[instruction.constant]->location);
+                break;
+            }
+            case GetCallee:
+            {
+                m_stack.emplace_back(new Function(frame->function));
+                break;
+            }
+
+            case Closure:
             {
-                Value &index = CONSTANT;
+                auto closure = new Function(*CONSTANT.get<Function>());
+
+                for(auto &capture : closure->captures)
+                {
+                    if(capture.is_local && capture.index == Capture::Callee)
+                    {
+                        // closed from the start, it holds a copy of the function and nothing refers back to it
+                        auto upvalue = std::make_shared<Upvalue>(nullptr);
+
+                        upvalue->closed   = new Function(frame->function);
+                        upvalue->location = &upvalue->closed;
+
+                        closure->upvalues.push_back(std::move(upvalue));
+                    }
+                    else if(capture.is_local)
+                        closure->upvalues.push_back(capture_upvalue(&frame->base[capture.index]));
+                    else
+                        closure->upvalues.push_back(frame->function.upvalues[capture.index]);
+                }
 
-                m_stack.push_back(index);
+                m_stack.emplace_back(closure);
 
                 break;
             }
+            case CloseUpvalues:
+            {
+                close_upvalues(&frame->base[instruction.constant]);
+                break;
+            }
             case TypeCmp:
             {
                 Value v1 = pop();
@@ -276,9 +533,10 @@ InterpretResult VM::run()
                 break;
             }
 
+            // jump offsets are stored directly in the instruction
             case Jif:
             {
-                size_t offset = CONSTANT.as.number;
+                size_t offset = instruction.constant;
 
                 if(is_falsy(pop()))
                     pc += offset;
@@ -287,7 +545,7 @@ InterpretResult VM::run()
             }
             case Jump:
             {
-                size_t offset = CONSTANT.as.number;
+                size_t offset = instruction.constant;
 
                 pc += offset;
 
@@ -295,23 +553,74 @@ InterpretResult VM::run()
             }
             case RollBack:
             {
-                size_t offset = CONSTANT.as.number;
+                size_t offset = instruction.constant;
 
                 pc -= offset;
 
                 break;
             }
 
+            case TableSwitch:
+            {
+                pc = CONSTANT.get<JumpTable>()->dense_target(pop());
+                break;
+            }
+            case LookupSwitch:
+            {
+                pc = CONSTANT.get<JumpTable>()->lookup_target(pop());
+                break;
+            }
+
             case Call:
             {
-                auto arg_count = CONSTANT.as.number;
+                uint8_t arg_count = instruction.constant;
 
                 frame->pc = pc;
 
                 call(arg_count);
 
+                // io builtins suspend async calls
+                if(m_frame_cursor == m_driver_frame)
+                    return m_state;
+
                 frame = &m_frames[m_frame_cursor];
-                pc = frame->pc;
+                pc    = frame->pc;
+                chunk = frame->function.chunk.get();
+
+                break;
+            }
+
+            // the operand is the natives index in the native table and the arg count
+            case CallNative:
+            {
+                auto &native = builtin::natives()[instruction.constant >> 8];
+
+                frame->pc = pc;
+
+                set_fn_params(native.param_count, instruction.constant & UINT8_MAX);
+
+                m_state = native.fn(*this);
+
+                // io builtins suspend async calls
+                if(m_frame_cursor == m_driver_frame)
+                    return m_state;
+
+                frame = &m_frames[m_frame_cursor];
+                pc    = frame->pc;
+                chunk = frame->function.chunk.get();
+
+                break;
+            }
+
+            case Import:
+            {
+                frame->pc = pc;
+
+                import_module(*CONSTANT.get<String>());
+
+                frame = &m_frames[m_frame_cursor];
+                pc    = frame->pc;
+                chunk = frame->function.chunk.get();
 
                 break;
             }
@@ -336,15 +645,122 @@ InterpretResult VM::run()
                 break;
             }
 
-            case SetFromTuple:
+            case ConstructMap:
+            {
+                size_t length = instruction.constant;
+
+                if(m_stack.size() < length * 2)
+                    return runtime_error("not enough values on stack for map construction");
+
+                auto map = new Map(length);
+                Value result = map;
+
+                auto start = m_stack.end() - length * 2;
+
+                for(auto it = start; it != m_stack.end(); it += 2)
+                {
+                    if(!Map::hashable(*it))
+                        return runtime_error("map keys must be numbers, booleans or strings");
+
+                    map->set(std::move(*it), std::move(*(it + 1)));
+                }
+
+                m_stack.erase(start, m_stack.end());
+                m_stack.push_back(std::move(result));
+
+                break;
+            }
+
+            case GetIndex: get_index(); break;
+            case SetIndex: set_index(); break;
+
+            case DupTwo:
             {
-                uint16_t id_count = CONSTANT.as.address;
+                auto [a, b] = top_two();
+
+                Value first = a;
+                Value second = b;
 
-                set_from_tuple(id_count);
+                m_stack.push_back(std::move(first));
+                m_stack.push_back(std::move(second));
 
                 break;
             }
 
+            case Iterate:
+            {
+                Value *base = pop().as.address;
+
+                // a coroutine pushes whether the loop goes on once it yields or returns
+                if(auto coroutine = base[0].get<Coroutine>(); coroutine && coroutine->is(ObjectType::Coroutine))
+                {
+                    base[3] = base[1];
+                    base[1].as.integer++;
+
+                    frame->pc = pc;
+
+                    resume(coroutine->fiber, Value(nullptr), base);
+
+                    frame = &m_frames[m_frame_cursor];
+                    pc    = frame->pc;
+                    chunk = frame->function.chunk.get();
+
+                    break;
+                }
+
+                m_stack.emplace_back(iterate(base));
+
+                break;
+            }
+
+            case Yield:
+            {
+                if(!m_fiber)
+                    return runtime_error("yield outside of a coroutine");
+
+                frame->pc = pc;
+
+                suspend(pop(), false);
+
+                if(m_frame_cursor == m_driver_frame)
+                    return m_state;
+
+                frame = &m_frames[m_frame_cursor];
+                pc    = frame->pc;
+                chunk = frame->function.chunk.get();
+
+                break;
+            }
+
+            case Resume:
+            {
+                Value value = instruction.constant ? pop() : Value(nullptr);
+                Value top   = pop();
+
+                auto coroutine = top.get<Coroutine>();
+
+                if(!coroutine || !coroutine->is(ObjectType::Coroutine))
+                    return runtime_error("only coroutines can be resumed");
+
+                frame->pc = pc;
+
+                resume(coroutine->fiber, std::move(value));
+
+                frame = &m_frames[m_frame_cursor];
+                pc    = frame->pc;
+                chunk = frame->function.chunk.get();
+
+                break;
+            }
+
+            case ParallelFor: parallel_for(); break;
+
+            case SetFromTuple:
+            {
+                set_from_tuple(instruction.constant);
+                break;
+            }
+
             case NoOp: break;
 
             case Return:
@@ -352,10 +768,32 @@ InterpretResult VM::run()
                 if(m_frame_cursor <= 0)
                     return m_state;
 
+                close_upvalues(frame->base);
+
+                // clears the locals so their objects are freed now rather than when the slots are reused
+                for(uint16_t i = 0; i < frame->function.slot_count; i++)
+                    frame->base[i] = nullptr;
+
+                m_data_top = frame->base;
+
                 frame->pc = pc;
 
                 frame = &m_frames[--m_frame_cursor];
-                pc = frame->pc;
+
+                // returning from the function a coroutine started with finishes it
+                if(m_fiber && m_frame_cursor == m_fiber->base_frame)
+                {
+                    suspend(pop(), true);
+
+                    frame = &m_frames[m_frame_cursor];
+                }
+
+                // back at the frame the event loop or a host call started from
+                if(m_frame_cursor == m_driver_frame)
+                    return m_state;
+
+                pc    = frame->pc;
+                chunk = frame->function.chunk.get();
             }
         }
     }
@@ -366,7 +804,10 @@ InterpretResult VM::run()
 InterpretResult VM::runtime_error(std::string_view message)
 {
     CallFrame frame   = m_frames[m_frame_cursor];
-    Bytes instruction = frame.function.chunk.bytes[frame.pc];
+    Bytes instruction = frame.function.chunk->bytes[frame.pc];
+
+    // keeps the error after anything the script printed before it
+    m_output.flush();
 
     fmt::eprint("[runtime error on line {}] {}",
             instruction.line,
@@ -402,6 +843,18 @@ inline bool VM::is_tuple(Value &value) const
     (value.type == ValueType::Object && value.as.object->type() != ObjectType::Tuple);
 }
 
+inline bool VM::numeric_operands() const
+{
+    auto [a, b] = top_two();
+    return a.is_number() && b.is_number();
+}
+
+bool VM::integer_operands(int64_t &a, int64_t &b) const
+{
+    auto [lhs, rhs] = top_two();
+    return lhs.as_integer(a) && rhs.as_integer(b);
+}
+
 bool VM::same_operands() const
 {
     auto [a, b] = top_two();
@@ -425,10 +878,10 @@ VM::top_two() const
 
 inline Chunk &VM::chunk()
 {
-    return m_frames[m_frame_cursor].function.chunk;
+    return *m_frames[m_frame_cursor].function.chunk;
 }
 
-void VM::call(double arg_count)
+void VM::call(uint8_t arg_count)
 {
     Value top = pop();
 
@@ -457,31 +910,299 @@ void VM::call(double arg_count)
         return;
     }
 
+    push_frame(std::move(*fn), arg_count);
+}
+
+bool VM::push_frame(Function &&fn, uint8_t arg_count)
+{
+    if(fn.lazy && !Compiler::compile_lazy(fn))
+    {
+        runtime_error("function body failed to compile");
+        return false;
+    }
+
+    if(m_frame_cursor + 1 >= MaxCallFrames || fn.slot_count > m_data_end - m_data_top)
+    {
+        runtime_error("stack overflow");
+        return false;
+    }
+
     CallFrame &new_frame = m_frames[++m_frame_cursor];
 
-    new_frame.function = std::move(*fn);
-    new_frame.pc = 0;
+    new_frame.function = std::move(fn);
+    new_frame.pc      = 0;
+    new_frame.base    = m_data_top;
+    new_frame.globals = new_frame.function.globals ? new_frame.function.globals : m_data.data();
+
+    m_data_top += new_frame.function.slot_count;
+
+    set_fn_params(new_frame.function.param_count, arg_count);
 
-    set_fn_params(fn->param_count, arg_count);
+    return true;
+}
+
+InterpretResult VM::call_function(const Function &function, uint8_t arg_count)
+{
+    uint8_t cursor    = m_frame_cursor;
+    Value  *data_top  = m_data_top;
+    size_t stack_size = m_stack.size() - arg_count;
+
+    int driver = std::exchange(m_driver_frame, m_frame_cursor);
+
+    // copying a function only copies its captures, a top level one has none so the call does not allocate
+    if(push_frame(Function(function), arg_count))
+        run();
+
+    m_driver_frame = driver;
+
+    if(m_state == InterpretResult::Ok)
+        return m_state;
+
+    // a failed call can leave frames, locals and values anywhere so everything above where it started is dropped
+    close_upvalues(data_top);
+
+    std::fill(data_top, std::max(data_top, m_data_top), nullptr);
+
+    m_data_top     = data_top;
+    m_frame_cursor = cursor;
+
+    m_stack.resize(stack_size);
+    m_fiber.reset();
+
+    return std::exchange(m_state, InterpretResult::Ok);
+}
+
+namespace
+{
+    // points the functions of a module and every function declared inside them at the modules globals
+    void bind_globals(Function &fn, Value *globals)
+    {
+        fn.globals = globals;
+
+        // the chunk is shared with the cached module program, so this vm binds a copy of its own
+        fn.chunk = std::make_shared<Chunk>(*fn.chunk);
+
+        for(auto &constant : fn.chunk->constants)
+        {
+            if(constant.type == ValueType::Object && constant.as.object->type() == ObjectType::Function)
+                bind_globals(*constant.get<Function>(), globals);
+        }
+    }
+}
+
+void VM::import_module(const String &name)
+{
+    // a module that is still running because of a cyclic import sees nil here since its exports are not built yet
+    if(auto it = m_modules.find(name.data); it != m_modules.end())
+    {
+        m_stack.push_back(it->second.globals[it->second.size-1]);
+        return;
+    }
+
+    const Function *program = module::load(name.data);
+
+    if(!program)
+    {
+        runtime_error(fmt::format("could not import module '{}'", name.data));
+        return;
+    }
+
+    if(m_frame_cursor + 1 >= MaxCallFrames)
+    {
+        runtime_error("stack overflow");
+        return;
+    }
+
+    Module &loaded = m_modules[name.data];
+
+    loaded.size    = program->slot_count;
+    loaded.globals = std::make_unique<Value[]>(loaded.size);
+
+    Function init = *program;
+
+    bind_globals(init, loaded.globals.get());
+
+    // everything the top level of a module declares lives in its own globals so the frame needs no slots
+    init.slot_count = 0;
+
+    CallFrame &new_frame = m_frames[++m_frame_cursor];
+
+    new_frame.function = std::move(init);
+    new_frame.pc       = 0;
+    new_frame.base     = m_data_top;
+    new_frame.globals  = loaded.globals.get();
+}
+
+void VM::resume(const std::shared_ptr<Fiber> &fiber, Value &&value, Value *loop_base)
+{
+    using Status = Fiber::Status;
+
+    // a finished coroutine ends a for loop over it
+    if(fiber->status == Status::Done && loop_base)
+    {
+        m_stack.emplace_back(false);
+        return;
+    }
+
+    if(fiber->status != Status::Suspended)
+    {
+        runtime_error(fiber->status == Status::Done
+                      ? "cannot resume a finished coroutine"
+                      : "cannot resume a running coroutine");
+        return;
+    }
+
+    Function &function = fiber->function;
+
+    if(!fiber->started && function.lazy && !Compiler::compile_lazy(function))
+    {
+        runtime_error("function body failed to compile");
+        return;
+    }
+
+    size_t frame_count = fiber->started ? fiber->frames.size() : 1;
+
+    if(m_frame_cursor + frame_count >= MaxCallFrames || function.slot_count > FiberSlots)
+    {
+        runtime_error("stack overflow");
+        return;
+    }
+
+    if(!fiber->started)
+    {
+        fiber->slots    = std::make_unique<Value[]>(FiberSlots);
+        fiber->data_top = fiber->slots.get();
+        fiber->data_end = fiber->slots.get() + FiberSlots;
+    }
+
+    fiber->status     = Status::Running;
+    fiber->resumer    = std::move(m_fiber);
+    fiber->base_frame = m_frame_cursor;
+    fiber->loop_base  = loop_base;
+
+    m_fiber = fiber;
+
+    std::swap(m_stack, fiber->stack);
+    std::swap(m_open_upvalues, fiber->open_upvalues);
+    std::swap(m_data_top, fiber->data_top);
+    std::swap(m_data_end, fiber->data_end);
+
+    if(fiber->started)
+    {
+        for(auto &saved : fiber->frames)
+            m_frames[++m_frame_cursor] = std::move(saved);
+
+        fiber->frames.clear();
+
+        // what the yield it was suspended at evaluates to
+        m_stack.push_back(std::move(value));
+
+        return;
+    }
+
+    fiber->started = true;
+
+    CallFrame &new_frame = m_frames[++m_frame_cursor];
+
+    new_frame.function = Function(function);
+    new_frame.pc       = 0;
+    new_frame.base     = m_data_top;
+    new_frame.globals  = function.globals ? function.globals : m_data.data();
+
+    m_data_top += function.slot_count;
+
+    // the first resume passes its value as the first argument
+    if(function.param_count > 0)
+    {
+        m_stack.push_back(std::move(value));
+        set_fn_params(function.param_count, 1);
+    }
+}
+
+InterpretResult VM::drive(const std::shared_ptr<Fiber> &fiber, Value &&value)
+{
+    int driver = std::exchange(m_driver_frame, m_frame_cursor);
+
+    resume(fiber, std::move(value));
+
+    if(m_state == InterpretResult::Ok)
+        run();
+
+    m_driver_frame = driver;
+
+    if(m_state == InterpretResult::Ok)
+        m_stack.pop_back();
+
+    return m_state;
+}
+
+EventLoop &VM::events()
+{
+    if(!m_events)
+        m_events = std::make_unique<EventLoop>();
+
+    return *m_events;
+}
+
+void VM::suspend(Value &&value, bool done)
+{
+    using Status = Fiber::Status;
+
+    // keeps the coroutine alive until the switch is over even if nothing else refers to it anymore
+    std::shared_ptr<Fiber> fiber = std::move(m_fiber);
+
+    // a finished coroutine has no frames left above its resumers
+    for(size_t i = fiber->base_frame + 1; i <= m_frame_cursor; i++)
+        fiber->frames.push_back(std::move(m_frames[i]));
+
+    m_frame_cursor = fiber->base_frame;
+
+    std::swap(m_stack, fiber->stack);
+    std::swap(m_open_upvalues, fiber->open_upvalues);
+    std::swap(m_data_top, fiber->data_top);
+    std::swap(m_data_end, fiber->data_end);
+
+    m_fiber = std::move(fiber->resumer);
+
+    Value *loop_base = std::exchange(fiber->loop_base, nullptr);
+
+    fiber->status = done ? Status::Done : Status::Suspended;
+
+    if(done)
+    {
+        fiber->stack.clear();
+        fiber->slots.reset();
+    }
+
+    if(!loop_base)
+    {
+        m_stack.push_back(std::move(value));
+        return;
+    }
+
+    if(!done)
+        loop_base[2] = std::move(value);
+
+    m_stack.emplace_back(!done);
 }
 
 void VM::set_from_tuple(uint16_t id_count)
 {
-    uint16_t start_index = pop().as.address;
+    Value *start = pop().as.address;
 
     Value top = pop();
 
-    const auto nullify = [&](uint16_t start, uint8_t length)
+    const auto nullify = [&](Value *start, uint8_t length)
     {
         for(uint8_t i = 0; i < length; i++)
-            m_data[start++] = nullptr;
+            *start++ = nullptr;
     };
 
     if(is_tuple(top))
     {
-        m_data[start_index] = std::move(top);
+        *start = std::move(top);
 
-        nullify(++start_index, id_count);
+        nullify(++start, id_count);
 
         return;
     }
@@ -489,10 +1210,326 @@ void VM::set_from_tuple(uint16_t id_count)
     auto tuple = top.get<Tuple>();
 
     for(auto &item : tuple->data)
-        m_data[start_index++] = std::move(item);
+        *start++ = std::move(item);
 
     if(id_count > tuple->length)
-        nullify(start_index, id_count-tuple->length);
+        nullify(start, id_count-tuple->length);
+}
+
+// adds what one part of a parallel for returned to the sums so far, element by element for tuples
+static bool add_partial(Value &sum, Value &&partial)
+{
+    if(sum.type == ValueType::Int && partial.type == ValueType::Int)
+    {
+        int64_t result;
+
+        if(add_overflow(sum.as.integer, partial.as.integer, &result))
+            sum = Value((double)sum.as.integer + (double)partial.as.integer);
+        else
+            sum.as.integer = result;
+
+        return true;
+    }
+
+    if(sum.is_number() && partial.is_number())
+    {
+        sum = Value(sum.as_double() + partial.as_double());
+        return true;
+    }
+
+    auto sums  = sum.get<Tuple>();
+    auto parts = partial.get<Tuple>();
+
+    if(!sums || !parts || !sums->is(ObjectType::Tuple) || !parts->is(ObjectType::Tuple) || sums->length != parts->length)
+        return false;
+
+    for(uint8_t i = 0; i < sums->length; i++)
+    {
+        if(!add_partial(sums->data[i], std::move(parts->data[i])))
+            return false;
+    }
+
+    return true;
+}
+
+void VM::parallel_for()
+{
+    Value body = pop();
+    Value to   = pop();
+    Value from = pop();
+
+    if(from.type != ValueType::Int || to.type != ValueType::Int)
+    {
+        runtime_error("parallel for loops only go over integer ranges");
+        return;
+    }
+
+    int64_t start  = from.as.integer;
+    uint64_t length = to.as.integer > start ? (uint64_t)to.as.integer - start : 0;
+
+    // a few parts per worker so workers that finish early can steal the rest
+    uint64_t parts = std::clamp<uint64_t>(length, 1, scheduler::worker_count() * 4);
+
+    std::vector<Value> globals = this->globals();
+
+    for(auto &global : globals)
+        global = scheduler::isolate(global).value_or(Value(nullptr));
+
+    // anything printed before the loop should not show up after what its body prints
+    m_output.flush();
+
+    std::vector<scheduler::Handle> handles;
+
+    for(uint64_t i = 0; i < parts; i++)
+    {
+        // the first length % parts parts take one more index than the rest
+        int64_t first = start + i * (length / parts) + std::min(i, length % parts);
+        int64_t last  = first + length / parts + (i < length % parts);
+
+        // every part gets its own copy of what the body captured
+        auto function = scheduler::isolate(body);
+
+        if(!function.has_value())
+        {
+            runtime_error("parallel for body cannot be passed to another thread");
+            return;
+        }
+
+        std::vector<Value> args;
+
+        args.emplace_back(first);
+        args.emplace_back(last);
+
+        handles.push_back(scheduler::spawn(std::move(*function->get<Function>()), std::move(args), std::vector<Value>(globals)));
+    }
+
+    Value sum;
+    bool failed = false;
+
+    for(size_t i = 0; i < handles.size(); i++)
+    {
+        auto partial = scheduler::await(handles[i]);
+
+        if(!partial.has_value())
+            failed = true;
+        else if(i == 0)
+            sum = std::move(partial.value());
+        else if(!failed && !add_partial(sum, std::move(partial.value())))
+        {
+            runtime_error("parallel for loops can only reduce numbers");
+            return;
+        }
+    }
+
+    if(failed)
+    {
+        runtime_error("parallel for body failed");
+        return;
+    }
+
+    m_stack.push_back(std::move(sum));
+}
+
+void VM::get_index()
+{
+    Value key       = pop();
+    Value container = pop();
+
+    // subscripts on variables pass the variables address so the container is not copied
+    Value &target = container.type == ValueType::Address ? *container.as.address : container;
+
+    if(target.type != ValueType::Object)
+    {
+        runtime_error("value is not subscriptable");
+        return;
+    }
+
+    switch(target.as.object->type())
+    {
+        case ObjectType::Map:
+        {
+            if(!Map::hashable(key))
+            {
+                runtime_error("map keys must be numbers, booleans or strings");
+                return;
+            }
+
+            Value *value = target.get<Map>()->find(key);
+
+            // the members of a module are the addresses of its globals
+            if(value && value->type == ValueType::Address)
+                m_stack.push_back(*value->as.address);
+            else if(value)
+                m_stack.push_back(*value);
+            else
+                m_stack.emplace_back(nullptr);
+
+            break;
+        }
+        case ObjectType::Tuple:
+        {
+            auto tuple = target.get<Tuple>();
+
+            size_t index;
+
+            if(!key.as_index(index) || index >= tuple->data.size())
+            {
+                runtime_error("tuple index out of range");
+                return;
+            }
+
+            m_stack.push_back(tuple->data[index]);
+
+            break;
+        }
+        default:
+            runtime_error("value is not subscriptable");
+    }
+}
+
+void VM::set_index()
+{
+    Value value     = pop();
+    Value key       = pop();
+    Value container = pop();
+
+    if(container.type != ValueType::Address)
+    {
+        runtime_error("only variables can be assigned through a subscript");
+        return;
+    }
+
+    Value &target = *container.as.address;
+
+    if(target.type != ValueType::Object)
+    {
+        runtime_error("value is not subscriptable");
+        return;
+    }
+
+    switch(target.as.object->type())
+    {
+        case ObjectType::Map:
+        {
+            if(!Map::hashable(key))
+            {
+                runtime_error("map keys must be numbers, booleans or strings");
+                return;
+            }
+
+            auto map = target.get<Map>();
+
+            // assigning nil removes the key
+            if(value.type == ValueType::Nil)
+                map->erase(key);
+            else
+                map->set(std::move(key), std::move(value));
+
+            break;
+        }
+        case ObjectType::Tuple:
+        {
+            auto tuple = target.get<Tuple>();
+
+            size_t index;
+
+            if(!key.as_index(index) || index >= tuple->data.size())
+            {
+                runtime_error("tuple index out of range");
+                return;
+            }
+
+            tuple->data[index] = std::move(value);
+
+            break;
+        }
+        default:
+            runtime_error("value is not subscriptable");
+    }
+}
+
+// the loop state lives in four contiguous slots starting at base
+// [collection, cursor, key, value] the cursor is advanced and the key and value are written for the next entry
+bool VM::iterate(Value *base)
+{
+    Value &collection = base[0];
+    Value &cursor     = base[1];
+
+    if(collection.type != ValueType::Object)
+    {
+        runtime_error("value is not iterable");
+        return false;
+    }
+
+    size_t position = cursor.as.integer;
+
+    switch(collection.as.object->type())
+    {
+        case ObjectType::Map:
+        {
+            auto map = collection.get<Map>();
+
+            position = map->next(position);
+
+            if(position >= map->buckets.size())
+                return false;
+
+            Value &value = map->buckets[position].value;
+
+            base[2] = map->buckets[position].key;
+            base[3] = value.type == ValueType::Address ? *value.as.address : value;
+
+            break;
+        }
+        // tuples bind the element first and its index second
+        case ObjectType::Tuple:
+        {
+            auto tuple = collection.get<Tuple>();
+
+            if(position >= tuple->data.size())
+                return false;
+
+            base[2] = tuple->data[position];
+            base[3] = Value((int64_t)position);
+
+            break;
+        }
+        default:
+            runtime_error("value is not iterable");
+            return false;
+    }
+
+    cursor.as.integer = position + 1;
+
+    return true;
+}
+
+// reuses the open upvalue for a slot so every closure capturing it shares the variable
+std::shared_ptr<Upvalue> VM::capture_upvalue(Value *slot)
+{
+    for(auto &upvalue : m_open_upvalues)
+    {
+        if(upvalue->location == slot)
+            return upvalue;
+    }
+
+    return m_open_upvalues.emplace_back(std::make_shared<Upvalue>(slot));
+}
+
+// moves the values of every open upvalue at or above from into the upvalue itself
+void VM::close_upvalues(Value *from)
+{
+    std::erase_if(m_open_upvalues, [from](auto &upvalue)
+    {
+        if(upvalue->location < from)
+            return false;
+
+        upvalue->closed    = std::move(*upvalue->location);
+        *upvalue->location = nullptr;
+        upvalue->location  = &upvalue->closed;
+
+        return true;
+    });
 }
 
 void VM::set_fn_params(uint8_t param_count, uint8_t arg_count)
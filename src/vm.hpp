@@ -7,9 +7,14 @@
 
 #include "types/chunk.hpp"
 #include "objects/function.hpp"
+#include "objects/string.hpp"
+#include "io.hpp"
+#include "event_loop.hpp"
 
 #define DEBUG_TRACE false
 
+struct Fiber;
+
 constexpr uint16_t MaxDataSize = sizeof(Value) * 1000;
 constexpr uint8_t MaxCallFrames = 255;
 
@@ -24,6 +29,10 @@ struct CallFrame
 {
     Function  function{};
     size_t    pc{};
+    // first of the frames local slots in the vms memory
+    Value    *base{};
+    // the globals of the program or module the function belongs to
+    Value    *globals{};
 };
 
 class VM
@@ -32,6 +41,31 @@ public:
 
     InterpretResult interpret(std::string_view source);
 
+    // runs an already compiled program such as one loaded from the cache
+    InterpretResult interpret(Function &&program);
+
+    /*
+     * runs a program without taking it, so one compiled program can run on many vms at once (one per thread).
+     * the bytecode is shared and only read, everything the program creates lives in this vm
+     */
+    InterpretResult interpret(const Function &program);
+
+    // runs a program over globals restored from an image instead of ones set up by its own top level
+    InterpretResult interpret(Function &&program, std::vector<Value> &&globals);
+
+    // calls function with args over a copy of another vms globals and leaves what it returns on the stack.
+    // this is how tasks run, the vm can be reused for any number of them
+    InterpretResult invoke(Function &&function, std::vector<Value> &&args, std::vector<Value> &&globals);
+
+    /*
+     * calls function with the arg_count values on top of the stack as its args and leaves what it returns there,
+     * for hosts calling into a program that already ran. a call that fails leaves the vm as it was before it
+     */
+    InterpretResult call_function(const Function &function, uint8_t arg_count);
+
+    // copies of the global slots of the program that last ran, used to write an image
+    std::vector<Value> globals() const;
+
     VM()
     {
 
@@ -44,9 +78,38 @@ public:
     std::vector<Value> m_stack;
 
     std::array<Value, MaxDataSize> m_data; // the vms internal memory used for various things (caching, variables, functions)
+    Value *m_data_top{}; // globals sit at the bottom of m_data and every call reserves its locals above this
+    Value *m_data_end{}; // the end of the slots calls can reserve, a running coroutines slots end sooner
+    size_t m_global_count{}; // the globals at the bottom of m_data
+
+    // upvalues still pointing into a live frame, closed when their slot goes out of scope
+    std::vector<std::shared_ptr<Upvalue>> m_open_upvalues;
+
+    // the coroutine running right now, nullptr while the program itself runs
+    std::shared_ptr<Fiber> m_fiber;
+
+    // the frame that called loop() while the event loop runs a call or the one a host called a function from,
+    // run returns once control is back there
+    int m_driver_frame = -1;
+
+    // made by the first async call or io builtin
+    std::unique_ptr<EventLoop> m_events;
+
+    // every module gets globals of its own, the last slot holds its exports once it has run
+    struct Module
+    {
+        std::unique_ptr<Value[]> globals;
+        size_t size;
+    };
+
+    // modules imported so far by name, each one is only run by the first import
+    std::unordered_map<std::string, Module> m_modules;
 
     InterpretResult m_state = InterpretResult::Ok;
 
+    // stdout for scripts, line buffered on terminals and block buffered otherwise
+    mio::OutputBuffer m_output;
+
     InterpretResult run();
 
     InterpretResult runtime_error(std::string_view message);
@@ -57,6 +120,11 @@ public:
 
     bool same_operands() const;
 
+    bool numeric_operands() const;
+
+    // writes the top two values as ints if both are integral numbers
+    bool integer_operands(int64_t &a, int64_t &b) const;
+
     bool match(ValueType type) const;
 
     bool is_tuple(Value &value) const;
@@ -67,10 +135,41 @@ public:
 
     Chunk &chunk();
 
-    void call(double arg_count);
+    void call(uint8_t arg_count);
+
+    // sets up the frame for a call to fn, false if it failed with a runtime error
+    bool push_frame(Function &&fn, uint8_t arg_count);
+
+    // pushes the exports of a module, running it first if this is its first import
+    void import_module(const String &name);
+
+    // continues a coroutine until it yields or returns, what it gives back is pushed onto the resumers stack.
+    // value is what the yield it is suspended at evaluates to, or its argument the first time
+    void resume(const std::shared_ptr<Fiber> &fiber, Value &&value, Value *loop_base = nullptr);
+
+    // hands control back to whoever resumed the running coroutine along with value
+    void suspend(Value &&value, bool done);
+
+    // resumes an async call and runs it until it suspends or finishes, what it gives back is dropped
+    InterpretResult drive(const std::shared_ptr<Fiber> &fiber, Value &&value);
+
+    EventLoop &events();
 
     void set_from_tuple(uint16_t id_count);
 
+    void get_index();
+
+    void set_index();
+
+    bool iterate(Value *base);
+
+    // runs the body of a parallel for over parts of its range on the worker pool and pushes the sums of what they return
+    void parallel_for();
+
+    std::shared_ptr<Upvalue> capture_upvalue(Value *slot);
+
+    void close_upvalues(Value *from);
+
     void set_fn_params(uint8_t param_count, uint8_t arg_count);
 
 };